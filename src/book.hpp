@@ -0,0 +1,112 @@
+#pragma once
+
+#include "base.hpp"
+#include "move.hpp"
+#include "position_fwd.hpp"
+#include "pgn.hpp"
+
+//
+// Polyglot opening book (cf. http://hgm.nubati.net/book_format.html)
+//
+
+namespace Polyglot {
+  using Key = uint64_t;
+
+  // 768 piece-squares (piece kind = 2 * type + is_white), 4 castling rights, 8 en passant files and white to move
+  extern const array<Key, 781> random64;
+
+  Key computeKey(const Position&);
+
+  // Castling is encoded as king capturing rook
+  uint16_t encodeMove(const Move&);
+  Move decodeMove(const Position&, uint16_t); // kNoneMove if not legal
+}
+
+struct Book {
+  // 16 bytes big endian on file sorted by key
+  struct Entry {
+    Polyglot::Key key = 0;
+    uint16_t move = 0;
+    uint16_t weight = 0;
+    uint32_t learn = 0;
+  };
+  static_assert(sizeof(Entry) == 16);
+
+  // Read-only mmap of file
+  const uint8_t* data = nullptr;
+  size_t size = 0; // Number of entries
+  void* mapped = nullptr;
+  size_t mapped_size = 0;
+
+  Book() {}
+  Book(const Book&) = delete;
+  ~Book() { unload(); }
+
+  bool isLoaded() const { return mapped; }
+  bool load(const string& filename); // False if not a book file
+  void unload();
+
+  Entry getEntry(size_t i) const {
+    Entry entry;
+    std::memcpy(&entry, data + i * sizeof(Entry), sizeof(Entry));
+    entry.key = __builtin_bswap64(entry.key);
+    entry.move = __builtin_bswap16(entry.move);
+    entry.weight = __builtin_bswap16(entry.weight);
+    entry.learn = __builtin_bswap32(entry.learn);
+    return entry;
+  }
+
+  // Binary search of entries with the key
+  vector<Entry> probe(Polyglot::Key) const;
+
+  // Legal moves with weights
+  vector<pair<Move, int>> probe(const Position&) const;
+
+  // Random move proportional to weight (kNoneMove if no move or all weights are zero)
+  static Move pickMove(const vector<pair<Move, int>>&, uint32_t random);
+
+  // Sort and write entries (e.g. for book_builder)
+  static void write(const string& filename, vector<Entry>);
+};
+
+// Aggregate (key, move) statistics of PGN games into book entries
+struct BookBuilder {
+  struct Stats {
+    uint32_t wins = 0, draws = 0, losses = 0; // For side to move
+
+    Stats& operator+=(const Stats& other) { wins += other.wins; draws += other.draws; losses += other.losses; return *this; }
+  };
+
+  using Key = pair<Polyglot::Key, uint16_t>; // (position, move)
+  struct KeyHash {
+    size_t operator()(const Key& key) const { return key.first ^ (uint64_t(key.second) * 0x9E3779B97F4A7C15ULL); }
+  };
+  using Map = std::unordered_map<Key, Stats, KeyHash>;
+
+  // Sharded by position key so that threads rarely contend
+  static inline constexpr int kNumShards = 64;
+  struct Shard {
+    std::mutex mutex;
+    Map map;
+  };
+  array<Shard, kNumShards> shards;
+
+  int max_ply = 30;
+  std::atomic<int64_t> num_games = 0;
+  std::atomic<int64_t> num_positions = 0;
+  std::atomic<int64_t> num_errors = 0; // Games with illegal move from initial position (only moves before it are used)
+  std::atomic<int64_t> num_skipped = 0; // Games from set-up position ("FEN" tag e.g. Chess960), which are not used
+
+  static int getShard(Polyglot::Key key) { return key >> 58; }
+
+  // Replay a game and accumulate into local map
+  void addGame(const Pgn::Game&, Map&);
+
+  void merge(Map&);
+
+  // Read games in batches from multiple threads
+  void build(std::istream&, int num_threads, int batch_size = 1024);
+
+  // Weight as Polyglot (2 * wins + draws) scaled to 16 bits, dropping moves with less games or zero weight
+  vector<Book::Entry> getEntries(int min_games = 1);
+};
@@ -0,0 +1,62 @@
+#include "book.hpp"
+#include "position.hpp"
+#include "timeit.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("BookBuilder::build") {
+  // Random games in PGN where moves are written with origin square (e.g. "Ng1f3"), which SAN parser also accepts
+  const int kNumGames = 1000, kNumPlies = 40;
+  const array<string, 3> kResults = {"1-0", "0-1", "1/2-1/2"};
+  std::ostringstream ostr;
+  Rng rng;
+  for (int i = 0; i < kNumGames; i++) {
+    auto result = kResults[rng.next() % 3];
+    ostr << "[Event \"?\"]\n[Result \"" << result << "\"]\n\n";
+    Position pos;
+    for (int ply = 0; ply < kNumPlies; ply++) {
+      MoveList moves;
+      pos.generateMoves(moves);
+      vector<Move> legal_moves;
+      for (auto move : moves) { if (pos.isLegal(move)) { legal_moves.push_back(move); } }
+      if (legal_moves.empty()) { break; }
+      auto move = legal_moves[rng.next() % legal_moves.size()];
+      if (ply % 2 == 0) { ostr << (ply / 2 + 1) << ". "; }
+      if (move.type() == kCastling) {
+        ostr << (move.castlingSide() == kOO ? "O-O" : "O-O-O");
+      } else {
+        PieceType type = pos.pieceOn(pos.side_to_move, move.from());
+        if (type != kPawn) { ostr << kFenPiecesMappingInverse[0][type]; }
+        ostr << toString(move).substr(0, 4);
+        if (move.type() == kPromotion) { ostr << "=" << kFenPiecesMappingInverse[0][move.promotionType()]; }
+      }
+      ostr << " ";
+      pos.makeMove(move);
+    }
+    ostr << result << "\n\n";
+  }
+  auto pgn = ostr.str();
+
+  auto run = [&](int num_threads) {
+    int64_t num_positions = 0, num_errors = 0;
+    auto result = timeit::run([&]() {
+      std::istringstream istr(pgn);
+      BookBuilder builder;
+      builder.build(istr, num_threads);
+      num_positions = builder.num_positions;
+      num_errors = builder.num_errors;
+      return builder.num_games.load();
+    }, 1, 5);
+    auto mean = std::get<0>(result);
+    return toString("positions:", num_positions, "errors:", num_errors, "usec/game:", mean * 1e6 / kNumGames, "(" + toString(timeit::Printer{result}) + ")");
+  };
+
+  SECTION("1 thread") {
+    INFO(run(1));
+    SUCCEED();
+  }
+
+  SECTION("4 threads") {
+    INFO(run(4));
+    SUCCEED();
+  }
+}
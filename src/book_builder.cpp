@@ -0,0 +1,37 @@
+#include "book.hpp"
+
+int main(int argc, const char* argv[]) {
+  Cli cli{argc, argv};
+  auto infile = cli.getArg<string>("--infile"); // PGN ("-" for stdin)
+  auto outfile = cli.getArg<string>("--outfile");
+  int num_threads = cli.getArg<int>("--threads").value_or(std::thread::hardware_concurrency());
+  int max_ply = cli.getArg<int>("--max-ply").value_or(30);
+  int min_games = cli.getArg<int>("--min-games").value_or(1);
+  if (!infile || !outfile || num_threads <= 0 || max_ply <= 0) {
+    std::cerr << cli.help() << std::endl;
+    return 1;
+  }
+
+  std::ifstream ifstr;
+  if (*infile != "-") {
+    ifstr.open(*infile);
+    if (!ifstr) { std::cerr << ":: cannot open " << *infile << std::endl; return 1; }
+  }
+  std::istream& istr = (*infile == "-") ? std::cin : ifstr;
+
+  auto start = std::chrono::steady_clock::now();
+  auto builder = std::make_unique<BookBuilder>();
+  builder->max_ply = max_ply;
+  builder->build(istr, num_threads);
+  auto entries = builder->getEntries(min_games);
+  Book::write(*outfile, entries);
+  auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  std::cerr << ":: games     = " << builder->num_games << std::endl;
+  std::cerr << ":: errors    = " << builder->num_errors << std::endl;
+  std::cerr << ":: skipped   = " << builder->num_skipped << std::endl;
+  std::cerr << ":: positions = " << builder->num_positions << std::endl;
+  std::cerr << ":: entries   = " << entries.size() << std::endl;
+  std::cerr << ":: time      = " << time << "ms" << std::endl;
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "book.hpp"
+#include "engine.hpp"
+#include "test_utils.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("Polyglot::computeKey") {
+  // Same position by transposition
+  Position pos1, pos2;
+  for (auto move : {Move(kG1, kF3), Move(kG8, kF6), Move(kB1, kC3)}) { pos1.makeMove(move); }
+  for (auto move : {Move(kB1, kC3), Move(kG8, kF6), Move(kG1, kF3)}) { pos2.makeMove(move); }
+  CHECK(Polyglot::computeKey(pos1) == Polyglot::computeKey(pos2));
+  CHECK(Polyglot::computeKey(pos1) != Polyglot::computeKey(Position()));
+
+  // En passant square matters only when capture is possible
+  CHECK(Polyglot::computeKey(Position("4k3/8/8/8/4P3/8/8/4K3 b - e3 0 1")) == Polyglot::computeKey(Position("4k3/8/8/8/4P3/8/8/4K3 b - - 0 1")));
+  CHECK(Polyglot::computeKey(Position("4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1")) != Polyglot::computeKey(Position("4k3/8/8/8/3pP3/8/8/4K3 b - - 0 1")));
+
+  // Reference keys of Polyglot's book format
+  auto check = [](const string& moves, Polyglot::Key expected) {
+    Position pos;
+    std::istringstream istr(moves);
+    string s;
+    while (istr >> s) { pos.makeMove(pos.parseUCI(s)); }
+    CHECK(Polyglot::computeKey(pos) == expected);
+  };
+  check("", 0x463b96181691fc9cULL);
+  check("e2e4", 0x823c9b50fd114196ULL);
+  check("e2e4 d7d5", 0x0756b94461c50fb0ULL);
+  check("e2e4 d7d5 e4e5", 0x662fafb965db29d4ULL);
+  check("e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ULL);
+  check("e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ULL);
+  check("e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ULL);
+  check("a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ULL);
+  check("a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ULL);
+}
+
+TEST_CASE("Polyglot::encodeMove") {
+  Position pos("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+  CHECK(Polyglot::encodeMove(Move(kE1, kG1, kCastling)) == ((kE1 << 6) | kH1));
+  CHECK(Polyglot::decodeMove(pos, (kE1 << 6) | kA1) == Move(kE1, kC1, kCastling));
+  CHECK(Polyglot::decodeMove(pos, (kE1 << 6) | kE3) == kNoneMove);
+  CHECK(Polyglot::encodeMove(Move(kA7, kA8, kPromotion, kQueen)) == ((4 << 12) | (kA7 << 6) | kA8));
+}
+
+TEST_CASE("Book") {
+  Position pos;
+  auto key = Polyglot::computeKey(pos);
+  vector<Book::Entry> entries = {
+    {key, Polyglot::encodeMove(Move(kD2, kD4)), 1, 0},
+    {key, Polyglot::encodeMove(Move(kE2, kE4)), 3, 0},
+    {key, Polyglot::encodeMove(Move(kA2, kA3)), 0, 0},
+    {key - 1, Polyglot::encodeMove(Move(kH2, kH3)), 1, 0},
+    {key + 1, Polyglot::encodeMove(Move(kH2, kH3)), 1, 0},
+  };
+  string filename = test_utils::makeTempPath("book-test.bin");
+  Book::write(filename, entries);
+
+  Book book;
+  REQUIRE(book.load(filename));
+  CHECK(book.size == 5);
+  CHECK(book.probe(key + 2).empty());
+  auto moves = book.probe(pos);
+  CHECK(toString(moves) == "{(e2e4, 3), (d2d4, 1), (a2a3, 0)}");
+
+  // Proportional to weight
+  array<int, 2> counts = {};
+  for (uint32_t random = 0; random < 100; random++) { counts[Book::pickMove(moves, random) == Move(kD2, kD4)]++; }
+  CHECK(counts == array<int, 2>{75, 25});
+  CHECK(Book::pickMove({{Move(kA2, kA3), 0}}, 0) == kNoneMove);
+
+  // Engine answers without search
+  Engine engine;
+  REQUIRE(engine.loadBook(filename));
+  engine.go_parameters.depth = 6;
+  engine.go(/* blocking */ true);
+  auto& result = engine.results.back();
+  CHECK(result.stats_nodes == 1);
+  CHECK((result.pv.data[0] == Move(kE2, kE4) || result.pv.data[0] == Move(kD2, kD4)));
+
+  // Search even in book for "go mate"
+  engine.go_parameters.mate = 1;
+  engine.go(/* blocking */ true);
+  CHECK(engine.results.back().stats_nodes > 1);
+  engine.go_parameters.mate = 0;
+
+  // and for "go infinite" which waits for "stop"
+  int64_t num_nodes = 0;
+  engine.search_result_callback = [&](const SearchResult& res) { num_nodes = std::max(num_nodes, res.stats_nodes); };
+  engine.go_parameters.infinite = true;
+  engine.go(/* blocking */ false);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  engine.stop();
+  CHECK(num_nodes > 1);
+  engine.go_parameters.infinite = false;
+
+  // Search out of book
+  engine.position.makeMove(Move(kE2, kE4));
+  engine.go(/* blocking */ true);
+  CHECK(engine.results.back().stats_nodes > 1);
+
+  std::remove(filename.c_str());
+  CHECK_FALSE(book.load(filename));
+
+  // Directory can be opened but not mapped
+  auto dir = test_utils::makeTempPath("book-dir");
+  std::filesystem::create_directories(dir);
+  CHECK_FALSE(book.load(dir));
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Pgn") {
+  std::istringstream istr(
+    "[Event \"?\"]\n"
+    "[Result \"1-0\"]\n"
+    "\n"
+    "1. e4 {comment} e5 2. Nf3 $1 (2. f4 exf4 (2... d5)) Nc6 ; comment\n"
+    "3. Bb5 a6 1-0\n"
+    "\n"
+    "[Event \"?\"]\n"
+    "[Result \"1/2-1/2\"]\n"
+    "[SetUp \"1\"]\n"
+    "[FEN \"4k3/8/8/8/8/8/3P4/4K3 w - - 0 1\"]\n"
+    "\n"
+    "1.d4 Kd7 2.d5 1/2-1/2\n"
+  );
+  Pgn::Reader reader(istr);
+  string text;
+  REQUIRE(reader.next(text));
+  auto game = Pgn::parseGame(text);
+  CHECK(game.result == Pgn::kWhiteWin);
+  CHECK(toString(game.moves) == "{e4, e5, Nf3, Nc6, Bb5, a6}");
+  CHECK(game.fen == "");
+  REQUIRE(reader.next(text));
+  game = Pgn::parseGame(text);
+  CHECK(game.result == Pgn::kDraw);
+  CHECK(toString(game.moves) == "{d4, Kd7, d5}");
+  CHECK(game.fen == "4k3/8/8/8/8/8/3P4/4K3 w - - 0 1");
+  CHECK_FALSE(reader.next(text));
+}
+
+TEST_CASE("BookBuilder") {
+  string pgn;
+  for (int i = 0; i < 30; i++) {
+    pgn += (i % 3 == 0) ? "[Result \"0-1\"]\n\n1. d4 d5 0-1\n\n" : "[Result \"1-0\"]\n\n1. e4 e5 2. Nf3 1-0\n\n";
+  }
+  pgn += "[Result \"1-0\"]\n\n1. e4 Ke7 1-0\n\n"; // Illegal move
+  pgn += "[Result \"0-1\"]\n[SetUp \"1\"]\n[FEN \"rnbqkb1r/pppppppp/5n2/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 2 2\"]\n\n2. e4 e5 0-1\n\n"; // Moves legal also from initial position
+  std::istringstream istr(pgn);
+  BookBuilder builder;
+  builder.build(istr, /* num_threads */ 4, /* batch_size */ 2);
+  CHECK(builder.num_games == 32);
+  CHECK(builder.num_errors == 1);
+  CHECK(builder.num_skipped == 1);
+  CHECK(builder.num_positions == 10 * 2 + 20 * 3 + 1);
+
+  string filename = test_utils::makeTempPath("book-builder-test.bin");
+  Book::write(filename, builder.getEntries(/* min_games */ 2));
+  Book book;
+  REQUIRE(book.load(filename));
+
+  // e4: 21 wins, d4: 10 losses (weight 0 dropped)
+  Position pos;
+  CHECK(toString(book.probe(pos)) == "{(e2e4, 42)}");
+  pos.makeMove(Move(kE2, kE4));
+  CHECK(book.probe(pos).empty()); // e5: only losses
+  std::remove(filename.c_str());
+}
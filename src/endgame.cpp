@@ -0,0 +1,138 @@
+#include "endgame.hpp"
+#include "position.hpp"
+
+using namespace precomputation;
+
+namespace Endgame {
+
+MaterialKey fromCode(const string& code) {
+  MaterialKey key = 0;
+  Color color = kWhite;
+  for (auto c : code) {
+    if (c == 'v') { color = kBlack; continue; }
+    ASSERT(kFenPiecesMapping.count(c));
+    key += toMaterialKey(color, kFenPiecesMapping[c][1]);
+  }
+  return key;
+}
+
+void Table::add(const string& code, Handler handler, Color strong) {
+  auto key = fromCode(code);
+  int i = getIndex(key);
+  while (entries[i].handler) { i = (i + 1) % kSize; }
+  entries[i] = {key, handler, strong};
+}
+
+namespace {
+
+bool isDarkSquare(Square sq) { return (SQ::toFile(sq) + SQ::toRank(sq)) % 2 == 0; }
+
+// 0 (center) .. 6 (corner)
+int getEdgeDistance(Square sq) {
+  File f = SQ::toFile(sq);
+  Rank r = SQ::toRank(sq);
+  return std::max(kFileD - f, f - kFileE) + std::max(kRank4 - r, r - kRank5);
+}
+
+Score getMaterial(const Position& pos, Color color) {
+  Score res = 0;
+  for (PieceType type = 0; type < kKing; type++) {
+    res += kPieceValue[type] * Endgame::getCount(pos.state->material_key, color, type);
+  }
+  return res;
+}
+
+Score evaluateDraw(const Position&, Color) {
+  return kScoreDraw;
+}
+
+// Drive weak king to the edge with strong king close to it
+Score evaluateKXK(const Position& pos, Color strong) {
+  Square strong_king = pos.kingSQ(strong);
+  Square weak_king = pos.kingSQ(!strong);
+  return kScoreKnownWin + getMaterial(pos, strong) +
+         10 * getEdgeDistance(weak_king) + 10 * (7 - distance_table[strong_king][weak_king]);
+}
+
+// Same as KXK but mate is only possible in the corner of bishop's color
+Score evaluateKBNK(const Position& pos, Color strong) {
+  Square weak_king = pos.kingSQ(!strong);
+  bool dark = isDarkSquare(toSQ(pos.pieces[strong][kBishop]).front());
+  auto corners = dark ? array<Square, 2>{kA1, kH8} : array<Square, 2>{kA8, kH1};
+  int corner_distance = std::min(distance_table[weak_king][corners[0]], distance_table[weak_king][corners[1]]);
+  return evaluateKXK(pos, strong) + 20 * (7 - corner_distance);
+}
+
+// Minor piece each (KBvKN, KNvKN, opposite colored KBvKB) where mate is possible only with a king cornered
+// by its own piece's help, so the score stays close to draw favoring the king farther from the edge
+Score evaluateDrawish(const Position& pos, Color strong) {
+  Score material = getMaterial(pos, strong) - getMaterial(pos, !strong);
+  return material / 16 + 2 * (getEdgeDistance(pos.kingSQ(!strong)) - getEdgeDistance(pos.kingSQ(strong)));
+}
+
+Score evaluateKBKB(const Position& pos, Color strong) {
+  bool dark = isDarkSquare(toSQ(pos.pieces[strong][kBishop]).front());
+  if (dark == isDarkSquare(toSQ(pos.pieces[!strong][kBishop]).front())) { return kScoreDraw; } // Same colored
+  return evaluateDrawish(pos, strong);
+}
+
+// Same colored bishops cannot checkmate
+Score evaluateKBBK(const Position& pos, Color strong) {
+  Board bishops = pos.pieces[strong][kBishop];
+  Board dark = 0;
+  for (auto sq : toSQ(bishops)) { if (isDarkSquare(sq)) { dark |= toBB(sq); } }
+  if (dark == 0 || dark == bishops) { return kScoreDraw; }
+  return evaluateKXK(pos, strong);
+}
+
+Table makeTable() {
+  Table table;
+  for (Color strong : {kWhite, kBlack}) {
+    auto add = [&](string code, Handler handler) {
+      if (strong == kBlack) { // Swap sides
+        auto v = code.find('v');
+        code = code.substr(v + 1) + "v" + code.substr(0, v);
+      }
+      table.add(code, handler, strong);
+    };
+
+    // No forced mate (exact draw)
+    if (strong == kWhite) { add("KvK", evaluateDraw); }
+    add("KNvK", evaluateDraw);
+    add("KBvK", evaluateDraw);
+    add("KNNvK", evaluateDraw);
+
+    // Mate exists but only by blunder (close to draw)
+    add("KBvKN", evaluateDrawish);
+    if (strong == kWhite) {
+      add("KNvKN", evaluateDrawish);
+      add("KBvKB", evaluateKBKB);
+    }
+
+    // Known win against bare king (bounded)
+    add("KQvK", evaluateKXK);
+    add("KRvK", evaluateKXK);
+    add("KBNvK", evaluateKBNK);
+    add("KBBvK", evaluateKBBK);
+  }
+  return table;
+}
+
+}; // namespace
+
+const Table table = makeTable();
+
+bool isInsufficientMaterial(const Position& pos) {
+  auto key = pos.state->material_key;
+  if (key & kHeavyMask) { return false; }
+  int num_knights = getCount(key, kWhite, kKnight) + getCount(key, kBlack, kKnight);
+  int num_bishops = getCount(key, kWhite, kBishop) + getCount(key, kBlack, kBishop);
+  if (num_knights + num_bishops <= 1) { return true; }
+  if (num_knights > 0) { return false; }
+  Board bishops = pos.pieces[kWhite][kBishop] | pos.pieces[kBlack][kBishop];
+  Board dark = 0;
+  for (auto sq : toSQ(bishops)) { if (isDarkSquare(sq)) { dark |= toBB(sq); } }
+  return dark == 0 || dark == bishops;
+}
+
+}; // namespace Endgame
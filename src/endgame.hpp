@@ -0,0 +1,73 @@
+#pragma once
+
+#include "base.hpp"
+#include "evaluation.hpp"
+#include "position_fwd.hpp"
+
+//
+// Material signature and specialized evaluation of trivial endgames
+//
+
+namespace Endgame {
+
+// Piece counts packed in 4 bits for each (color, piece type), which is updated incrementally (cf. Position::putPiece)
+// and identifies material signature without collision.
+using MaterialKey = uint64_t;
+
+constexpr int getShift(Color color, PieceType type) { return 4 * (6 * color + type); }
+
+constexpr MaterialKey toMaterialKey(Color color, PieceType type) { return MaterialKey(1) << getShift(color, type); }
+
+inline int getCount(MaterialKey key, Color color, PieceType type) { return (key >> getShift(color, type)) & 15; }
+
+// Swap white and black pieces
+inline MaterialKey flipColors(MaterialKey key) {
+  constexpr int shift = getShift(kBlack, 0);
+  return (key >> shift) | ((key & ((MaterialKey(1) << shift) - 1)) << shift);
+}
+
+// Pawns, rooks and queens of both sides
+constexpr MaterialKey kHeavyMask =
+    (15 * (toMaterialKey(kWhite, kPawn) | toMaterialKey(kWhite, kRook) | toMaterialKey(kWhite, kQueen))) |
+    (15 * (toMaterialKey(kBlack, kPawn) | toMaterialKey(kBlack, kRook) | toMaterialKey(kBlack, kQueen)));
+
+// From code e.g. "KBNvK" (white pieces before "v")
+MaterialKey fromCode(const string& code);
+
+// Score for strong side, either exact (drawn material), close to draw (mate only by blunder) or bounded (known win is at least kScoreKnownWin)
+using Handler = Score (*)(const Position&, Color strong);
+
+const inline Score kScoreKnownWin = kScoreWin / 2;
+
+struct Table {
+  struct Entry {
+    MaterialKey key = 0;
+    Handler handler = nullptr;
+    Color strong = kWhite;
+  };
+
+  // Open addressing (there are only a few dozens of signatures)
+  static inline constexpr int kSize = 64;
+  array<Entry, kSize> entries = {};
+
+  static int getIndex(MaterialKey key) { return (key * 0x9E3779B97F4A7C15ULL) >> 58; }
+
+  void add(const string& code, Handler handler, Color strong);
+
+  const Entry* probe(MaterialKey key) const {
+    for (int i = getIndex(key); entries[i].handler; i = (i + 1) % kSize) {
+      if (entries[i].key == key) { return &entries[i]; }
+    }
+    return nullptr;
+  }
+};
+
+extern const Table table;
+
+// Null if the material doesn't have specialized evaluation
+inline const Table::Entry* probe(MaterialKey key) { return table.probe(key); }
+
+// Neither side can ever checkmate (K vs K with at most a single minor piece or only same colored bishops)
+bool isInsufficientMaterial(const Position&);
+
+}; // namespace Endgame
@@ -3,34 +3,53 @@
 
 void TimeControl::initialize(const GoParameters& go, Color own, int ply) {
   start = now();
-  double duration = kInfDuration;
+  double soft = kInfDuration, hard = kInfDuration;
   if (go.movetime != 0) {
-    duration = std::min(duration, (double)go.movetime);
+    soft = hard = std::max(1.0, double(go.movetime - move_overhead));
   }
+  use_soft_limit = (go.time[own] != 0);
   if (go.time[own] != 0) {
-    double time = go.time[own];
+    double time = std::max(1.0, double(go.time[own] - move_overhead));
     double inc = go.inc[own];
     int cnt = go.movestogo ? go.movestogo : std::max(10, 32 - ply / 2);
-    duration = std::min(duration, (time + inc * (cnt - 1)) / cnt); // Split remaining time to each move
+    double target = (time + inc * (cnt - 1)) / cnt; // Split remaining time to each move
 
     if (ply <= 8) {
       double opening_time = 1000.0 + (1000. / 8.) * ply;
-      duration = std::min(duration, opening_time);
+      target = std::min(target, opening_time);
     }
+    target *= kSafeFactor;
+    hard = std::min({hard, kHardFactor * target, kMaxUsage * time});
+    soft = std::min({soft, target, hard});
   }
-  finish = start + Msec(int64_t(kSafeFactor * duration));
+  duration = Msec(int64_t(hard));
+  soft_duration = Msec(int64_t(soft));
+  origin = go.ponder ? start + Msec(int64_t(kInfDuration)) : start;
 };
 
+bool TimeControl::checkSoftLimit(double factor, int64_t next_iteration_time) {
+  if (!use_soft_limit) { return 1; }
+  auto elapsed = std::chrono::duration_cast<Msec>(now() - origin.load(std::memory_order_relaxed)).count(); // Negative while pondering
+  if (elapsed >= factor * soft_duration.count()) { return 0; }
+  if (elapsed + next_iteration_time >= duration.count()) { return 0; } // Not worth starting since result would be discarded
+  return 1;
+}
+
 void SearchResult::print(std::ostream& ostr) const {
   if (type == kSearchResultInfo) {
     if (!debug.empty()) {
       ostr << toString("info string DEBUG", debug);
 
     } else {
+      ostr << "info depth " << depth;
+      if (multipv > 0) { ostr << " multipv " << multipv; }
+      if (Evaluation::isMateScore(score)) {
+        ostr << toString(" score mate", Evaluation::toMateMoves(score));
+      } else {
+        ostr << toString(" score cp", score);
+      }
       ostr << toString(
-        "info depth", depth,
-        "score cp", score,
-        "time", stats_time,
+        " time", stats_time,
         "nodes", stats_nodes,
         "nps", (1000 * stats_nodes) / stats_time,
         "pv"
@@ -42,14 +61,19 @@ void SearchResult::print(std::ostream& ostr) const {
   if (type == kSearchResultBestMove) {
     ASSERT(pv.size() > 0);
     ostr << toString("bestmove", pv.data[0]);
+    if (pv.size() >= 2) { ostr << toString(" ponder", pv.data[1]); }
   }
 }
 
 void Engine::print(std::ostream& ostr) {
   ostr << ":: Position" << "\n";
   ostr << position;
-  ostr << ":: Evaluation" << "\n";
+  ostr << ":: Evaluation (" << evaluator.architecture() << ")" << "\n";
   ostr << evaluator.evaluate() << "\n";
+  if (position.small_evaluator) {
+    ostr << ":: Evaluation (small " << small_evaluator.architecture() << ")" << "\n";
+    ostr << small_evaluator.evaluate() << "\n";
+  }
 }
 
 void Engine::stop() {
@@ -68,14 +92,40 @@ void Engine::wait() {
   ASSERT(!go_thread_future.valid());
 }
 
+void Engine::ponderhit() {
+  if (!isRunning() || !pondering.load(std::memory_order_acquire)) { return; }
+  time_control.ponderhit();
+  pondering.store(false, std::memory_order_release);
+}
+
 bool Engine::checkSearchLimit() {
   if (stop_requested.load(std::memory_order_acquire)) { return 0; }
+  if (go_parameters.nodes && num_nodes >= go_parameters.nodes) { return 0; }
   if (!time_control.checkLimit()) { return 0; }
   return 1;
 }
 
+void Engine::initializeRootMoves() {
+  MoveList moves;
+  position.generateMoves(moves);
+  root_moves.clear();
+  int num_legals = 0;
+  for (auto move : moves) {
+    if (!position.isLegal(move)) { continue; }
+    num_legals++;
+    auto& searchmoves = go_parameters.searchmoves;
+    if (searchmoves.empty() || std::find(searchmoves.begin(), searchmoves.end(), move) != searchmoves.end()) { root_moves.put(move); }
+  }
+  // Ignore "searchmoves" without legal move
+  if (root_moves.empty()) {
+    for (auto move : moves) { if (position.isLegal(move)) { root_moves.put(move); } }
+  }
+  root_restricted = (int)root_moves.size() < num_legals;
+}
+
 void Engine::go(bool blocking) {
   ASSERT(!go_thread_future.valid()); // Check previous Engine::go met with Engine::wait
+  pondering.store(go_parameters.ponder, std::memory_order_release); // Before "ponderhit" can arrive
   go_thread_future = std::async([this]() { goImpl(); return true; });
   ASSERT(go_thread_future.valid());
   if (blocking) { wait(); }
@@ -83,6 +133,16 @@ void Engine::go(bool blocking) {
 
 void Engine::goImpl() {
   time_control.initialize(go_parameters, position.side_to_move, position.game_ply);
+  evaluation_cache.resetStats();
+  num_nodes = 0;
+
+  if (deterministic) {
+    transposition_table.reset();
+    evaluation_cache.reset();
+    history = {};
+    book_rng = {};
+    for (auto& search_state : search_state_stack) { search_state.killers = {}; } // Root killers survive SearchState::reset
+  }
 
   if (debug) {
     SearchResult info;
@@ -96,34 +156,80 @@ void Engine::goImpl() {
     search_result_callback(info);
   }
 
+  // Book move might not be in "searchmoves" and answers neither "go infinite" (bestmove only after "stop") nor "go mate"
+  initializeRootMoves();
+  bool use_book = !go_parameters.ponder && !go_parameters.infinite && !go_parameters.mate && !root_restricted;
+  if (use_book && goBook()) { return; }
+
+  // "go mate N" searches up to the node after N-th move (which has no legal move if mated)
   int depth_end = go_parameters.depth;
+  if (go_parameters.mate > 0) { depth_end = std::min(depth_end, 2 * go_parameters.mate); }
   ASSERT(depth_end > 0);
   results.assign(depth_end + 1, {});
 
   int best_index = 0;
 
-  // Get random first move just in case we don't even have time for "depth 1"
-  Move first_move = position.getRandomMove();
-  ASSERT(first_move != kNoneMove);
+  // Get first move just in case we don't even have time for "depth 1"
+  ASSERT(!root_moves.empty());
+  Move first_move = root_moves[0];
   results[0] = { .type = kSearchResultInfo, .depth = 1, .score = 0, .stats_time = 1, .stats_nodes = 1 };
   results[0].pv.put(first_move);
+
+  // Number of PV slots ("multipv 1" is sent for the main line whenever MultiPV > 1)
+  int num_pvs = std::min<int>(multi_pv, root_moves.size());
+  if (multi_pv > 1) { results[0].multipv = 1; }
   search_result_callback(results[0]);
+  multipv_results.clear();
+
+  // Best move stability and last iteration's time for time management
+  int stability = 0;
+  int64_t last_iteration_time = 0;
 
   // Iterative deepening
   for (int depth = 1; depth <= depth_end; depth++) {
-    SearchResult res;
-    if (depth < 4) {
-      res = search(depth);
-    } else {
-      res = searchWithAspirationWindow(depth, results[depth - 1].score);
+    int64_t iteration_start = time_control.getTime();
+
+    // k-th slot searches root without best moves of previous slots.
+    // Slots share TT/history and aspiration window is centered at previous depth's k-th score.
+    vector<SearchResult> slot_results;
+    root_excluded_moves.clear();
+    bool interrupted = false;
+    for (int k = 0; k < num_pvs; k++) {
+      SearchResult res;
+      if (depth < 4) {
+        res = search(depth);
+      } else {
+        Score target = (k < (int)multipv_results.size()) ? multipv_results[k].score : results[depth - 1].score;
+        res = searchWithAspirationWindow(depth, target);
+      }
+      if (!checkSearchLimit()) { interrupted = true; break; } // Ignore possibly incomplete result
+      if (res.pv.empty()) { break; } // All remaining root moves pruned
+      slot_results.push_back(res);
+      root_excluded_moves.put(res.pv[0]);
+    }
+    root_excluded_moves.clear();
+    if (slot_results.empty()) { break; }
+
+    // Rank slots by score (only complete depth)
+    if (multi_pv > 1 && !interrupted) {
+      std::stable_sort(slot_results.begin(), slot_results.end(), [](auto& x, auto& y) { return x.score > y.score; });
+      for (int k = 0; k < (int)slot_results.size(); k++) {
+        slot_results[k].type = kSearchResultInfo;
+        slot_results[k].multipv = k + 1;
+      }
+      multipv_results = slot_results;
     }
-    if (!checkSearchLimit()) { break; } // Ignore possibly incomplete result
 
-    // Save result and send "info ..."
+    // Save result and send "info ..." (then "info ... multipv k" for other slots)
+    SearchResult& res = slot_results[0];
     best_index = depth;
     results[depth] = res;
     results[depth].type = kSearchResultInfo;
+    if (multi_pv > 1) { results[depth].multipv = 1; } // Also when later slots are interrupted
     search_result_callback(results[depth]);
+    if (multi_pv > 1 && !interrupted) {
+      for (int k = 1; k < (int)slot_results.size(); k++) { search_result_callback(slot_results[k]); }
+    }
 
     // Debug info
     if (debug) {
@@ -136,10 +242,41 @@ void Engine::goImpl() {
         "tt_cut", res.stats_tt_cut,
         "refutation", res.stats_refutation,
         "futility_prune", res.stats_futility_prune,
-        "lmr", toString(res.stats_lmr_success) +  "/" + toString(res.stats_lmr)
+        "lmr", toString(res.stats_lmr_success) +  "/" + toString(res.stats_lmr),
+        "tb_hit", res.stats_tb_hit,
+        "eval_cache", toString(evaluation_cache.num_hits) + "/" + toString(evaluation_cache.num_probes)
       );
       search_result_callback(res_info);
     }
+
+    if (interrupted) { break; }
+
+    // Forced mate within requested moves is proven
+    if (go_parameters.mate > 0 && res.score >= Evaluation::mateScore(2 * go_parameters.mate - 1)) { break; }
+
+    // Scale soft limit by stability (shorter if best move is stable, longer if it changes or score drops)
+    // and don't start next iteration if it's predicted to overrun hard limit
+    int64_t iteration_time = time_control.getTime() - iteration_start;
+    if (depth >= 2) {
+      auto& prev = results[depth - 1];
+      double factor = 1.0;
+      if (prev.pv[0] != res.pv[0]) {
+        stability = 0;
+        factor *= 1.5;
+      } else {
+        stability++;
+        factor *= std::max(0.5, 1.0 - 0.1 * stability);
+      }
+      if (res.score + 30 < prev.score) { factor *= 1.3; }
+      double branching = last_iteration_time > 0 ? std::clamp(double(iteration_time) / last_iteration_time, 1.5, 4.0) : 2.0;
+      if (!time_control.checkSoftLimit(factor, branching * iteration_time)) { break; }
+    }
+    last_iteration_time = iteration_time;
+  }
+
+  // Hold "bestmove ..." until "ponderhit" or "stop" even if search finished early
+  while ((pondering.load(std::memory_order_acquire) || go_parameters.infinite) && !stop_requested.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
   }
 
   // Send "bestmove ..."
@@ -148,6 +285,34 @@ void Engine::goImpl() {
   search_result_callback(best);
 }
 
+bool Engine::goBook() {
+  if (!book.isLoaded()) { return false; }
+  auto moves = book.probe(position);
+  Move move = Book::pickMove(moves, book_rng.next());
+
+  if (debug) {
+    SearchResult info;
+    info.type = kSearchResultInfo;
+    std::ostringstream key;
+    Zobrist::print(Polyglot::computeKey(position), key);
+    info.debug = toString("book_key", key.str(), "book_moves", moves, "book_move", move);
+    search_result_callback(info);
+  }
+  if (move == kNoneMove) { return false; }
+
+  SearchResult res;
+  res.type = kSearchResultInfo;
+  res.depth = 1;
+  res.stats_time = 1;
+  res.stats_nodes = 1;
+  res.pv.put(move);
+  results.assign(1, res);
+  search_result_callback(res);
+  res.type = kSearchResultBestMove;
+  search_result_callback(res);
+  return true;
+}
+
 SearchResult Engine::searchWithAspirationWindow(int depth, Score init_target) {
   const Score kInitDelta = 25;
 
@@ -170,7 +335,7 @@ SearchResult Engine::searchWithAspirationWindow(int depth, Score init_target) {
 
     if (alpha < score && score < beta) {
       res.score = score;
-      res.pv = state->pv;
+      res.pv = state->getPV();
       res.stats_time = time_control.getTime() + 1;
       res.stats_aspiration = i;
       return res;
@@ -199,7 +364,7 @@ SearchResult Engine::search(int depth) {
 
   state->reset();
   res.score = searchImpl(-kScoreInf, kScoreInf, 0, depth, res);
-  res.pv = state->pv;
+  res.pv = state->getPV();
   res.stats_time = time_control.getTime() + 1;
   return res;
 }
@@ -208,9 +373,27 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
   if (!checkSearchLimit()) { return kScoreNone; }
   if (position.isDraw()) { return kScoreDraw; }
   if (depth >= Position::kMaxDepth) { return position.evaluate(); }
+
+  // Mate distance pruning (cut if mate from here can't be shorter than the one already found).
+  // Window itself is kept since lowered beta would lose PV by hash score cut.
+  if (depth > 0) {
+    Score mate_alpha = std::max(alpha, (Score)-Evaluation::mateScore(depth));
+    Score mate_beta = std::min(beta, Evaluation::mateScore(depth + 1));
+    if (mate_alpha >= mate_beta) { return mate_alpha; }
+  }
+
+  // Exact score from tablebase (except root which needs a move)
+  if (depth > 0) {
+    if (auto tb_result = tablebase.probe(position)) {
+      result.stats_tb_hit++;
+      return Tablebase::toScore(*tb_result, depth);
+    }
+  }
+
   if (depth >= depth_end) { return quiescenceSearch(alpha, beta, depth, result); }
 
   result.stats_nodes++;
+  num_nodes++;
   result.stats_max_depth = std::max(result.stats_max_depth, depth);
 
   TTEntry tt_entry;
@@ -222,6 +405,7 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
   NodeType node_type = kAllNode;
   Score score = -kScoreInf;
   Score evaluation = kScoreNone;
+  bool evaluation_exact = true; // False if by small network (cf. Engine::evaluate)
 
   bool interrupted = 0;
   int depth_to_go = depth_end - depth;
@@ -230,11 +414,13 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
   MoveList searched_quiets, searched_captures;
   int move_cnt = 0;
   int searched_move_cnt = 0;
+  bool root_excluding = (depth == 0 && (root_restricted || !root_excluded_moves.empty())); // TT is not for the subset of root moves
+  bool mate_search = go_parameters.mate > 0; // Unsound pruning/reduction could hide mate
 
   // Use lambda to skip from anywhere to the end
   ([&]() {
 
-    if (tt_hit) {
+    if (tt_hit && !root_excluding) {
       // Hash score cut
       if (depth_to_go <= tt_entry.depth) {
         if (beta <= tt_entry.score && (tt_entry.node_type == kCutNode || tt_entry.node_type == kPVNode)) {
@@ -259,11 +445,12 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
     }
 
     // Static evaluation
-    if (evaluation == kScoreNone) { evaluation = position.evaluate(); }
+    if (evaluation == kScoreNone) { evaluation = evaluate(alpha, beta, evaluation_exact); }
 
     MovePicker move_picker(position, history, tt_move, state->killers, in_check, /* quiescence */ false);
     Move move;
     while (move_picker.getNext(move)) {
+      if (root_excluding && isRootMoveSkipped(move)) { continue; }
       move_cnt++;
 
       bool is_capture = position.isCaptureOrPromotion(move);
@@ -272,7 +459,7 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
       (is_capture ? searched_captures : searched_quiets).put(move);
 
       // Futility pruning
-      if (!is_capture && !in_check && !gives_check && depth_to_go <= 3) {
+      if (!mate_search && !is_capture && !in_check && !gives_check && depth_to_go <= 3) {
         if (evaluation + 200 * depth_to_go < alpha && history_score < -10) {
           result.stats_futility_prune++;
           continue;
@@ -282,7 +469,7 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
       makeMove(move);
 
       // Late move reduction
-      if (!in_check && !gives_check && depth >= 1 && depth_to_go >= 3 && move_cnt >= 3) {
+      if (!mate_search && !in_check && !gives_check && depth >= 1 && depth_to_go >= 3 && move_cnt >= 3) {
         int reduction = 0;
         reduction += !is_capture;
         reduction += (history_score < 0);
@@ -316,7 +503,7 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
         node_type = kPVNode;
         alpha = score;
         best_move = move;
-        state->updatePV(move, (state + 1)->pv);
+        state->updatePV(move, *(state + 1));
       }
     }
 
@@ -331,10 +518,11 @@ Score Engine::searchImpl(Score alpha, Score beta, int depth, int depth_end, Sear
   if (interrupted) { return kScoreNone; }
 
   ASSERT(-kScoreInf < score && score < kScoreInf);
+  if (root_excluding) { return score; }
   tt_entry.node_type = node_type;
   tt_entry.move = best_move;
   tt_entry.score = score;
-  tt_entry.evaluation = evaluation;
+  tt_entry.evaluation = evaluation_exact ? evaluation : kScoreNone;
   tt_entry.depth = depth_to_go;
   transposition_table.put(position.state->key, tt_entry);
 
@@ -351,6 +539,7 @@ Score Engine::quiescenceSearch(Score alpha, Score beta, int depth, SearchResult&
   if (position.isDraw()) { return kScoreDraw; }
 
   result.stats_nodes++;
+  num_nodes++;
   result.stats_max_depth = std::max(result.stats_max_depth, depth);
 
   if (depth >= Position::kMaxDepth) { return position.evaluate(); }
@@ -364,6 +553,7 @@ Score Engine::quiescenceSearch(Score alpha, Score beta, int depth, SearchResult&
   NodeType node_type = kAllNode;
   Score score = -kScoreInf;
   Score evaluation = kScoreNone;
+  bool evaluation_exact = true; // False if by small network (cf. Engine::evaluate)
 
   bool interrupted = 0;
   bool in_check = position.state->checkers;
@@ -400,7 +590,7 @@ Score Engine::quiescenceSearch(Score alpha, Score beta, int depth, SearchResult&
     }
 
     // Static evaluation
-    if (evaluation == kScoreNone) { evaluation = position.evaluate(); }
+    if (evaluation == kScoreNone) { evaluation = evaluate(alpha, beta, evaluation_exact); }
 
     // Stand pat beta cut
     score = evaluation;
@@ -454,7 +644,7 @@ Score Engine::quiescenceSearch(Score alpha, Score beta, int depth, SearchResult&
   tt_entry.node_type = node_type;
   tt_entry.move = best_move;
   tt_entry.score = score;
-  tt_entry.evaluation = evaluation;
+  tt_entry.evaluation = evaluation_exact ? evaluation : kScoreNone;
   tt_entry.depth = 0;
   transposition_table.put(position.state->key, tt_entry);
 
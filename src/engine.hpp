@@ -1,6 +1,9 @@
 #include "position.hpp"
 #include "transposition_table.hpp"
 #include "nn/evaluator.hpp"
+#include "evaluation_cache.hpp"
+#include "tablebase.hpp"
+#include "book.hpp"
 
 enum SearchResultType { kSearchResultInfo, kSearchResultBestMove, kNoSearchResult };
 
@@ -16,8 +19,10 @@ struct SearchResult {
   int64_t stats_futility_prune = 0;
   int64_t stats_lmr = 0;
   int64_t stats_lmr_success = 0;
+  int64_t stats_tb_hit = 0;
   int stats_aspiration = -1;
   int stats_max_depth = 0;
+  int multipv = 0; // 1-based rank when MultiPV > 1 (otherwise 0)
   MoveList pv;
   string debug;
 
@@ -33,6 +38,11 @@ struct GoParameters {
   int64_t movestogo = 0;
   int64_t movetime = 0;
   int depth = Position::kMaxDepth;
+  int64_t nodes = 0; // No limit if 0
+  int mate = 0; // Mate in moves to prove (no limit if 0)
+  MoveList searchmoves; // Restrict root moves (all legal moves if empty)
+  bool ponder = false; // No time limit until "ponderhit"
+  bool infinite = false; // "bestmove" only after "stop" (also while pondering)
 };
 
 
@@ -42,32 +52,51 @@ struct TimeControl {
 
   static inline TimePoint now() { return std::chrono::steady_clock::now(); }
   static inline const double kSafeFactor = 0.9;
+  static inline const double kHardFactor = 4; // Hard limit is up to 4 times of soft limit
+  static inline const double kMaxUsage = 0.5; // and up to half of remaining time
   static inline const double kInfDuration = 1e12; // 10^12 msec ~ 30 years
 
-  TimePoint start, finish;
+  int64_t move_overhead = 10; // Subtracted from clock for transport latency (cf. "Move Overhead" option)
+
+  TimePoint start;
+  std::atomic<TimePoint> origin; // Limits are counted from here ("ponderhit" thread writes it when pondering)
+  Msec duration; // Hard limit (search is interrupted)
+  Msec soft_duration; // Soft limit scaled by search stability (next iteration is not started)
+  bool use_soft_limit = false; // Only for clock time (i.e. not for "movetime")
 
   void initialize(const GoParameters&, Color, int);
-  bool checkLimit() { return now() < finish; }
+  void ponderhit() { origin.store(now(), std::memory_order_relaxed); }
+  bool checkLimit() { return now() < origin.load(std::memory_order_relaxed) + duration; }
+  bool checkSoftLimit(double factor, int64_t next_iteration_time);
   int64_t getTime() { return std::chrono::duration_cast<Msec>(now() - start).count(); }
-  int64_t getDuration() { return std::chrono::duration_cast<Msec>(finish - start).count(); }
+  int64_t getDuration() { return std::chrono::duration_cast<Msec>(origin.load(std::memory_order_relaxed) + duration - start).count(); }
 };
 
 
 struct SearchState {
-  MoveList pv;
+  Move* pv = nullptr; // Row of triangular PV table (cf. Engine::pv_table)
+  int pv_length = 0;
   array<Move, 2> killers = {};
 
-  void updatePV(const Move& move, const MoveList& child_pv) {
-    pv.clear();
-    pv.put(move);
-    for (auto child : child_pv) { pv.put(child); }
+  // Copy only live moves of child's row
+  void updatePV(const Move& move, const SearchState& child) {
+    pv[0] = move;
+    std::copy_n(child.pv, child.pv_length, pv + 1);
+    pv_length = child.pv_length + 1;
+  }
+
+  MoveList getPV() const {
+    MoveList res;
+    for (int i = 0; i < pv_length; i++) { res.put(pv[i]); }
+    return res;
   }
 
   void reset() {
-    pv.clear();
+    pv_length = 0;
     (this + 1)->killers = {};
   }
 };
+static_assert(sizeof(SearchState) == 16);
 
 struct History {
   // For quiet moves (color, from, to)
@@ -83,8 +112,8 @@ struct History {
 
   Score& getCaptureScore(const Position& p, const Move& move) {
     Color own = p.side_to_move;
-    PieceType attacker = p.piece_on[ own][move.from()];
-    PieceType attackee = p.piece_on[!own][move.to()];
+    PieceType attacker = p.pieceOn(own, move.from());
+    PieceType attackee = p.pieceOn(!own, move.to());
     return capture[own][attacker][move.to()][attackee];
   }
 };
@@ -92,14 +121,23 @@ struct History {
 struct Engine {
   Position position;
   nn::Evaluator evaluator;
+  nn::Evaluator small_evaluator; // Optional second network (cf. Engine::evaluate)
+  bool small_weight_loaded = false;
   History history;
   TranspositionTable transposition_table;
+  EvaluationCache evaluation_cache;
+  Tablebase tablebase;
+  Book book;
+  Rng book_rng;
 
   GoParameters go_parameters = {};
   TimeControl time_control = {};
 
   std::atomic<bool> debug = 0;
+  bool deterministic = 0; // Clear search state on each "go" so that fixed depth/nodes search is reproducible
+  int64_t num_nodes = 0; // Nodes of current "go" (cf. GoParameters::nodes)
   std::atomic<bool> stop_requested = 0; // single reader ("go" thread) + single writer ("stop" thread)
+  std::atomic<bool> pondering = 0; // Set by "go" and cleared by "ponderhit"
 
   // Engine::wait invalidates future for the next Engine::go
   std::future<bool> go_thread_future;
@@ -107,36 +145,62 @@ struct Engine {
 
   // Result for each depth during iterative deepening
   vector<SearchResult> results;
+
+  // Top moves of last completed depth (cf. "MultiPV" option)
+  int multi_pv = 1;
+  vector<SearchResult> multipv_results;
+  MoveList root_moves; // Legal root moves of current "go" (cf. GoParameters::searchmoves)
+  bool root_restricted = false; // Root moves are subset of legal moves
+  MoveList root_excluded_moves; // Best moves of previous PV slots which root skips
   std::function<void(const SearchResult&)> search_result_callback = [](const SearchResult&){};
 
+  // Search/quiescence search stop at kMaxDepth (+1 for "reset" of last ply)
+  // and state at ply d owns (kMaxDepth + 1 - d) moves of triangular PV table.
+  static inline constexpr int kSearchStateStackSize = Position::kMaxDepth + 2;
+  static inline constexpr int kPVTableSize = (Position::kMaxDepth + 1) * (Position::kMaxDepth + 2) / 2;
   SearchState* state = nullptr;
-  array<SearchState, Position::kMaxDepth + 64> search_state_stack;
+  array<SearchState, kSearchStateStackSize> search_state_stack;
+  array<Move, kPVTableSize> pv_table;
 
   static inline const int kDefaultHashSizeMB = 128;
+  static inline const int kDefaultEvaluationCacheSizeMB = 4;
   static inline const string kEmbeddedWeightName = "__EMBEDDED_WEIGHT__";
+  static inline const Score kSmallNetworkMargin = 200;
 
   Engine() {
     loadWeight();
     position.evaluator = &evaluator;
     position.reset();
     setHashSizeMB(kDefaultHashSizeMB);
+    setEvaluationCacheSizeMB(kDefaultEvaluationCacheSizeMB);
     state = &search_state_stack[0];
+    for (int d = 0, offset = 0; d < kSearchStateStackSize; offset += Position::kMaxDepth + 1 - d, d++) {
+      search_state_stack[d].pv = pv_table.data() + offset;
+    }
   }
 
   void reset() {
     position.initialize(kFenInitialPosition);
     transposition_table.reset();
+    evaluation_cache.reset();
     history = {};
   }
 
   // "go" and "stop/wait" should be called from different threads
   void stop();
   void wait();
+  void ponderhit(); // Switch pondering search to timed search (keeping its state)
 
   // Iterative deepening
   void go(bool blocking);
   void goImpl();
+  bool goBook(); // True if book move is sent
   bool checkSearchLimit();
+  void initializeRootMoves();
+  bool isRootMoveSkipped(const Move& move) {
+    auto contains = [&](const MoveList& list) { return std::find(list.begin(), list.end(), move) != list.end(); };
+    return (root_restricted && !contains(root_moves)) || contains(root_excluded_moves);
+  }
 
   // Fixed depth alph-beta search (NOTE: Only usable from "go" method)
   SearchResult search(int);
@@ -144,6 +208,31 @@ struct Engine {
   Score searchImpl(Score, Score, int, int, SearchResult&);
   Score quiescenceSearch(Score, Score, int, SearchResult&);
 
+  // Static evaluation by small network if the score is clearly outside of (alpha, beta) by margin, otherwise by main network.
+  // Cached main network's score is used first. "exact" is false for small network's score, which depends on
+  // the window and so must not be reused as static evaluation (e.g. TT entry).
+  Score evaluate(Score alpha, Score beta, bool& exact) {
+    exact = true;
+    Score score;
+    if (evaluation_cache.get(position.state->key, score)) { return score; }
+    if (position.small_evaluator) {
+      score = position.evaluate(/* small */ true);
+      if (score + kSmallNetworkMargin <= alpha || beta <= score - kSmallNetworkMargin) { exact = false; return score; }
+    }
+    score = position.evaluate();
+    evaluation_cache.put(position.state->key, score);
+    return score;
+  }
+
+  // Main network evaluation through cache
+  Score evaluateCached() {
+    Score score;
+    if (evaluation_cache.get(position.state->key, score)) { return score; }
+    score = position.evaluate();
+    evaluation_cache.put(position.state->key, score);
+    return score;
+  }
+
   void makeMove(const Move& move);
   void unmakeMove(const Move& move);
   void updateKiller(const Move&);
@@ -153,9 +242,50 @@ struct Engine {
   void print(std::ostream& ostr = std::cerr);
 
   void setHashSizeMB(int mb) { transposition_table.resize(mb); }
+  void setEvaluationCacheSizeMB(int mb) { evaluation_cache.resizeMB(mb); }
 
-  void loadWeight(const string& filename = kEmbeddedWeightName) {
+  // Empty filename unloads book (false if not a book file)
+  bool loadBook(const string& filename) {
+    if (filename.empty()) { book.unload(); return true; }
+    return book.load(filename);
+  }
+
+  // Empty path unloads tablebase (returns the number of tables and invalid files are counted in "num_errors")
+  int loadTablebase(const string& dir, int* num_errors = nullptr) {
+    tablebase.clear();
+    if (num_errors) { *num_errors = 0; }
+    return dir.empty() ? 0 : tablebase.load(dir, num_errors);
+  }
+
+  // False if weight file is invalid or its architecture is not supported (then current weight is kept)
+  bool loadWeight(const string& filename = kEmbeddedWeightName) {
     if (filename == kEmbeddedWeightName) evaluator.loadEmbeddedWeight();
-    else evaluator.load(filename);
+    else if (!evaluator.load(filename)) { return false; }
+    if (position.evaluator) { evaluator.initialize(position); }
+    evaluation_cache.reset();
+    return true;
+  }
+
+  // Empty filename unloads small network
+  bool loadSmallWeight(const string& filename) {
+    if (filename.empty()) {
+      small_weight_loaded = false;
+      position.small_evaluator = nullptr;
+      return true;
+    }
+    return loadSmallWeight(nn::WeightFile::fromFile(filename));
+  }
+
+  bool loadSmallWeight(const std::shared_ptr<const nn::WeightFile>& file) {
+    if (!small_evaluator.load(file)) { return false; }
+    small_weight_loaded = true;
+    if (position.small_evaluator) { small_evaluator.initialize(position); }
+    return true;
+  }
+
+  // Only effective when small network is loaded
+  void setUseSmallNetwork(bool value) {
+    position.small_evaluator = (value && small_weight_loaded) ? &small_evaluator : nullptr;
+    if (position.small_evaluator) { small_evaluator.initialize(position); }
   }
 };
@@ -1,4 +1,5 @@
 #include "engine.hpp"
+#include "mate_solver.hpp"
 #include <catch2/catch_test_macros.hpp>
 #include "timeit.hpp"
 
@@ -32,3 +33,93 @@ TEST_CASE("Engine::go") {
     }
   }
 }
+
+// Crude small network for benchmark by keeping only first 32 accumulator units of embedded weight
+static std::shared_ptr<const nn::WeightFile> makeTruncatedWeight() {
+  constexpr int W1 = nn::DefaultArchitecture::WIDTH1, W2 = nn::DefaultArchitecture::WIDTH2, W3 = 32, W4 = 32, K = 32;
+  auto big = nn::WeightFile::fromMemory(nn::kEmbeddedWeight, nn::kEmbeddedWeightSize);
+  auto [w1, b1] = big->getLayer(0);
+  auto [w2, b2] = big->getLayer(1);
+  auto [w3, b3] = big->getLayer(2);
+  auto [w4, b4] = big->getLayer(3);
+
+  // Legacy layout (i.e. Linear weight is [out][in])
+  vector<float> data;
+  for (int i = 0; i < W1; i++) { data.insert(data.end(), w1 + i * W2, w1 + i * W2 + K); }
+  data.insert(data.end(), b1, b1 + K);
+  for (int o = 0; o < W3; o++) {
+    for (int j = 0; j < 2 * K; j++) {
+      int j_big = (j < K) ? j : (W2 + j - K);
+      data.push_back(w2[j_big * W3 + o] * (W2 / K));
+    }
+  }
+  data.insert(data.end(), b2, b2 + W3);
+  for (int o = 0; o < W4; o++) {
+    for (int j = 0; j < W3; j++) { data.push_back(w3[j * W4 + o]); }
+  }
+  data.insert(data.end(), b3, b3 + W4);
+  data.insert(data.end(), w4, w4 + W4);
+  data.insert(data.end(), b4, b4 + 1);
+  return nn::WeightFile::fromLegacy(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float), {W1, K, W3, W4, 1});
+}
+
+TEST_CASE("Engine::go (small network)") {
+  vector<string> fens = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1rk1/1p3ppp/5b2/p1pnN2N/3P4/P7/1PP2PPP/R1BQ1RK1 b - - 1 13"
+  };
+
+  Engine engine;
+  REQUIRE(engine.loadSmallWeight(makeTruncatedWeight()));
+
+  for (auto fen : fens) {
+    for (bool use_small : {false, true}) {
+      SECTION(fen + (use_small ? " (small)" : "")) {
+        engine.reset();
+        engine.setUseSmallNetwork(use_small);
+        engine.position.initialize(fen);
+        engine.go_parameters.depth = 7;
+        engine.go(/* blocking */ true);
+        auto& result = engine.results.back();
+        INFO(toString("nodes:", result.stats_nodes, "nps:", (1000 * result.stats_nodes) / result.stats_time, "time:", result.stats_time));
+        SUCCEED();
+      }
+    }
+  }
+}
+
+TEST_CASE("Engine::go (nodes)") {
+  // Fixed work independent of machine load (cf. Engine::deterministic)
+  Engine engine;
+  engine.deterministic = true;
+  engine.position.initialize("r1bq1rk1/1p3ppp/5b2/p1pnN2N/3P4/P7/1PP2PPP/R1BQ1RK1 b - - 1 13");
+  engine.go_parameters.nodes = 200000;
+  INFO(timeit::timeit([&]() {
+    engine.go(/* blocking */ true);
+    return engine.results.back();
+  }, 1, 4));
+  SUCCEED();
+}
+
+TEST_CASE("MateSolver") {
+  // Mate in 4 or 5 (df-pn doesn't need evaluation and depth iteration)
+  Engine engine;
+  engine.position.initialize("r1bqr3/ppp1B1kp/1b4p1/n2B4/3PQ1P1/2P5/P4P2/RN4K1 w - - 1 0");
+
+  SECTION("df-pn") {
+    MateSolver solver(engine.position);
+    INFO(timeit::timeit([&]() { return solver.solve(); }, 1, 4));
+    SUCCEED();
+  }
+
+  SECTION("go mate") {
+    engine.go_parameters.mate = 5;
+    INFO(timeit::timeit([&]() {
+      engine.transposition_table.reset();
+      engine.go(/* blocking */ true);
+      return engine.results.back();
+    }, 1, 1));
+    SUCCEED();
+  }
+}
@@ -1,4 +1,5 @@
 #include "engine.hpp"
+#include "test_utils.hpp"
 #include <config.hpp>
 #include <catch2/catch_test_macros.hpp>
 
@@ -32,3 +33,283 @@ TEST_CASE("Engine::go") {
   CHECK(bestmove.type == kSearchResultBestMove);
   CHECK(toString(bestmove.pv) == expected);
 }
+
+TEST_CASE("Engine::evaluate (small network)") {
+  Engine engine;
+
+  // Random small network
+  auto file = test_utils::makeWeightFile({10 * 64 * 64, 32, 32, 32, 1});
+
+  // Not effective until loaded
+  engine.setUseSmallNetwork(true);
+  CHECK(engine.position.small_evaluator == nullptr);
+  REQUIRE(engine.loadSmallWeight(file));
+  engine.setUseSmallNetwork(true);
+  REQUIRE(engine.position.small_evaluator == &engine.small_evaluator);
+  CHECK(engine.small_evaluator.architecture() == "HalfKP-32x32x32");
+
+  engine.position.initialize("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+  Score small = engine.position.evaluate(/* small */ true);
+  Score big = engine.position.evaluate();
+  bool exact;
+  CHECK(engine.evaluate(small + Engine::kSmallNetworkMargin, small + Engine::kSmallNetworkMargin + 1, exact) == small);
+  CHECK_FALSE(exact);
+  CHECK(engine.evaluate(small - 1, small + 1, exact) == big);
+  CHECK(exact);
+
+  // Cached main network's score is preferred regardless of window
+  CHECK(engine.evaluate(small + Engine::kSmallNetworkMargin, small + Engine::kSmallNetworkMargin + 1, exact) == big);
+  CHECK(exact);
+
+  // Small network is updated incrementally
+  engine.makeMove(Move(kC4, kC5));
+  nn::Evaluator expected = engine.small_evaluator;
+  expected.initialize(engine.position);
+  CHECK(engine.small_evaluator.evaluate() == expected.evaluate());
+  engine.unmakeMove(Move(kC4, kC5));
+
+  // Search still finds mate
+  vector<SearchResult> results;
+  engine.search_result_callback = [&](const SearchResult& result) { results.push_back(result); };
+  engine.position.initialize("8/3k4/6R1/7R/8/4K3/8/8 w - - 2 2");
+  engine.go_parameters.depth = 4;
+  engine.go(/* blocking */ true);
+  CHECK(toString(results.back().pv.data[0]) == "h5h7");
+  CHECK(results.back().pv.size() == 3);
+
+  engine.setUseSmallNetwork(false);
+  CHECK(engine.position.small_evaluator == nullptr);
+}
+
+TEST_CASE("EvaluationCache") {
+  EvaluationCache cache;
+  cache.resizeMB(1);
+  CHECK(cache.size == (1 << 17));
+
+  Score score = 0;
+  uint64_t key = 0x123456789abcdef0;
+  CHECK_FALSE(cache.get(key, score));
+  cache.put(key, -1234);
+  CHECK(cache.get(key, score));
+  CHECK(score == -1234);
+  CHECK_FALSE(cache.get(key ^ (1ULL << 63), score)); // Same index but different key
+  CHECK(cache.getHitRate() == 1.0 / 3.0);
+
+  // Disabled
+  cache.resizeMB(0);
+  cache.put(key, 1);
+  CHECK_FALSE(cache.get(key, score));
+}
+
+TEST_CASE("Engine::evaluateCached") {
+  Engine engine;
+  engine.position.initialize("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+  Score expected = engine.position.evaluate();
+  CHECK(engine.evaluateCached() == expected);
+  CHECK(engine.evaluateCached() == expected);
+  CHECK(engine.evaluation_cache.num_hits == 1);
+}
+
+TEST_CASE("Engine::go (endgame)") {
+  Engine engine;
+  engine.position.initialize("8/8/4k3/8/8/2K5/3R4/8 w - - 0 1");
+  engine.go_parameters.depth = 4;
+  engine.go(/* blocking */ true);
+  CHECK(engine.results.back().score >= Endgame::kScoreKnownWin);
+}
+
+TEST_CASE("Engine::go (ponder)") {
+  Engine engine;
+  std::atomic<int> num_bestmoves = 0;
+  engine.search_result_callback = [&](const SearchResult& result) { num_bestmoves += (result.type == kSearchResultBestMove); };
+  engine.position.initialize("8/3k4/6R1/7R/8/4K3/8/8 w - - 2 2");
+
+  // "bestmove" is held until "ponderhit" even if search finished
+  engine.go_parameters.depth = 2;
+  engine.go_parameters.ponder = true;
+  engine.go(/* blocking */ false);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  CHECK(engine.isRunning());
+  CHECK(num_bestmoves == 0);
+  engine.ponderhit();
+  engine.wait();
+  CHECK(num_bestmoves == 1);
+
+  // No time limit until "ponderhit" and then "movetime" applies
+  engine.go_parameters = {};
+  engine.go_parameters.ponder = true;
+  engine.go_parameters.movetime = 50;
+  engine.go(/* blocking */ false);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  CHECK(num_bestmoves == 1);
+  engine.ponderhit();
+  engine.wait();
+  CHECK(num_bestmoves == 2);
+  CHECK(engine.time_control.getTime() < 200 + 50 + 100);
+
+  // "stop" while pondering
+  engine.go(/* blocking */ false);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  engine.stop();
+  CHECK(num_bestmoves == 3);
+}
+
+TEST_CASE("TimeControl") {
+  TimeControl time_control;
+  GoParameters go;
+
+  // "movetime" without soft limit
+  go.movetime = 100;
+  time_control.initialize(go, kWhite, 0);
+  CHECK(time_control.duration.count() == 90);
+  CHECK(time_control.soft_duration.count() == 90);
+  CHECK(time_control.checkSoftLimit(0, 1000));
+
+  // Clock: soft limit as split time and hard limit up to its 4 times
+  go = {};
+  go.time[kWhite] = 10010;
+  time_control.initialize(go, kWhite, 40);
+  CHECK(time_control.soft_duration.count() == 750); // 10000 / 12 * 0.9
+  CHECK(time_control.duration.count() == 3000);
+  CHECK(time_control.checkSoftLimit(1, 0));
+  CHECK_FALSE(time_control.checkSoftLimit(0, 0)); // Past scaled soft limit
+  CHECK_FALSE(time_control.checkSoftLimit(1, 3000)); // Next iteration won't finish
+
+  // Up to half of remaining time
+  go.time[kWhite] = 1010;
+  go.inc[kWhite] = 1000;
+  time_control.initialize(go, kWhite, 40);
+  CHECK(time_control.duration.count() == 500);
+  CHECK(time_control.soft_duration.count() == 500);
+
+  // Limits start from "ponderhit"
+  go.ponder = true;
+  time_control.initialize(go, kWhite, 40);
+  CHECK(time_control.checkSoftLimit(0, 1000000));
+  time_control.ponderhit();
+  CHECK_FALSE(time_control.checkSoftLimit(0, 0));
+}
+
+TEST_CASE("Engine::go (clock)") {
+  Engine engine;
+  engine.position.initialize("r1bq1rk1/1p3ppp/5b2/p1pnN2N/3P4/P7/1PP2PPP/R1BQ1RK1 b - - 1 13");
+  engine.go_parameters.time[kBlack] = 3000;
+  engine.go(/* blocking */ true);
+  CHECK(engine.time_control.getTime() <= engine.time_control.duration.count() + 20);
+}
+
+TEST_CASE("Engine::go (nodes)") {
+  Engine engine;
+  engine.deterministic = true;
+  engine.position.initialize("r1bq1rk1/1p3ppp/5b2/p1pnN2N/3P4/P7/1PP2PPP/R1BQ1RK1 b - - 1 13");
+  engine.go_parameters.nodes = 20000;
+
+  // Exact budget and same iterations on each run
+  auto run = [&]() {
+    engine.go(/* blocking */ true);
+    CHECK(engine.num_nodes == 20000);
+    string res;
+    for (auto& result : engine.results) {
+      if (result.type == kNoSearchResult) { continue; }
+      res += toString(result.depth, result.score, result.stats_nodes, result.pv) + "\n";
+    }
+    return res;
+  };
+  CHECK(run() == run());
+
+  // Root fail high leaves killers at root, which must not affect next search
+  engine.position.initialize("8/3k4/6R1/7R/8/4K3/8/8 w - - 2 2");
+  auto first = run();
+  CHECK(engine.search_state_stack[0].killers[0] != kNoneMove);
+  CHECK(first == run());
+}
+
+TEST_CASE("Engine::go (MultiPV)") {
+  Engine engine;
+  engine.deterministic = true;
+  vector<SearchResult> infos;
+  engine.search_result_callback = [&](const SearchResult& result) {
+    if (result.type == kSearchResultInfo && result.multipv > 0) { infos.push_back(result); }
+  };
+  engine.position.initialize("r1bq1rk1/1p3ppp/5b2/p1pnN2N/3P4/P7/1PP2PPP/R1BQ1RK1 b - - 1 13");
+  engine.go_parameters.depth = 5;
+  engine.multi_pv = 4;
+  engine.go(/* blocking */ true);
+
+  // Distinct root moves ranked by score
+  auto& pvs = engine.multipv_results;
+  REQUIRE(pvs.size() == 4);
+  std::set<uint16_t> moves;
+  for (int k = 0; k < 4; k++) {
+    CHECK(pvs[k].multipv == k + 1);
+    moves.insert(pvs[k].pv[0].data);
+    if (k > 0) { CHECK(pvs[k - 1].score >= pvs[k].score); }
+  }
+  CHECK(moves.size() == 4);
+  CHECK(infos.size() == 1 + 4 * 5); // Including first move before depth 1
+  CHECK(toString(infos.back().pv) == toString(pvs[3].pv));
+  CHECK(engine.results.back().pv[0] == pvs[0].pv[0]);
+
+  // Numbered even when later slots are interrupted
+  vector<SearchResult> all_infos;
+  engine.search_result_callback = [&](const SearchResult& result) {
+    if (result.type == kSearchResultInfo && result.debug.empty()) { all_infos.push_back(result); }
+  };
+  engine.go_parameters.depth = Position::kMaxDepth;
+  engine.go_parameters.nodes = 50000;
+  engine.go(/* blocking */ true);
+  REQUIRE(!all_infos.empty());
+  for (auto& info : all_infos) { CHECK(info.multipv > 0); }
+  CHECK(all_infos.back().multipv == 1);
+  engine.go_parameters.nodes = 0;
+
+  // Not more than legal moves
+  engine.position.initialize("k7/8/8/8/8/8/6q1/7K w - - 0 1");
+  engine.go(/* blocking */ true);
+  CHECK(engine.multipv_results.size() == 1);
+}
+
+TEST_CASE("Engine::go (mate)") {
+  Engine engine;
+  vector<SearchResult> results;
+  engine.search_result_callback = [&](const SearchResult& result) { results.push_back(result); };
+
+  // Stop as soon as mate is proven
+  engine.position.initialize("8/3k4/6R1/7R/8/4K3/8/8 w - - 2 2");
+  engine.go_parameters.mate = 2;
+  engine.go(/* blocking */ true);
+  REQUIRE(results.size() >= 2);
+  auto& info = results[results.size() - 2];
+  CHECK(info.score == Evaluation::mateScore(3));
+  CHECK(info.depth <= 4);
+  CHECK(toString(info).rfind("info depth " + toString(info.depth) + " score mate 2 ", 0) == 0);
+  CHECK(results.back().pv[0] == Move(kH5, kH7));
+  CHECK(results.back().pv.size() == 3);
+
+  // Not found within depth
+  results.clear();
+  engine.position.initialize("8/8/2k5/7R/6R1/4K3/8/8 w - - 0 1");
+  engine.go_parameters.mate = 2;
+  engine.go(/* blocking */ true);
+  CHECK(results[results.size() - 2].depth == 4);
+  CHECK(!Evaluation::isMateScore(results[results.size() - 2].score));
+}
+
+TEST_CASE("Engine::go (searchmoves)") {
+  Engine engine;
+  engine.deterministic = true;
+  engine.position.initialize("8/3k4/6R1/7R/8/4K3/8/8 w - - 2 2");
+  engine.go_parameters.depth = 4;
+  engine.go_parameters.searchmoves.put(Move(kE3, kE4));
+  engine.go_parameters.searchmoves.put(Move(kE3, kF4));
+  engine.go(/* blocking */ true);
+  CHECK(engine.root_moves.size() == 2);
+  CHECK(engine.root_restricted);
+  auto best = engine.results.back().pv[0];
+  CHECK((best == Move(kE3, kE4) || best == Move(kE3, kF4)));
+
+  // Together with MultiPV
+  engine.multi_pv = 3;
+  engine.go(/* blocking */ true);
+  CHECK(engine.multipv_results.size() == 2);
+}
@@ -106,6 +106,12 @@ struct Evaluation {
 
   static inline Score mateScore(int ply) { return kScoreMate - ply; }
 
+  // Beyond range of static evaluation (cf. nn::Evaluator)
+  static inline bool isMateScore(Score score) { return std::abs(score) > kScoreWin; }
+
+  // Full moves to mate (negative when being mated) as "score mate <n>"
+  static inline int toMateMoves(Score score) { return score > 0 ? (kScoreMate - score + 1) / 2 : -(kScoreMate + score) / 2; }
+
   Score value() const {
     Score res = 0;
     res += piece_value[kWhite] - piece_value[kBlack];
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "base.hpp"
+#include "evaluation.hpp"
+
+//
+// Direct-mapped cache of static evaluation keyed by Zobrist key
+//
+// - Entry packs upper 48 bits of key and score into a single 64 bits word, so reads/writes are never torn
+//   without lock and 8 entries share a cache line.
+//
+
+struct EvaluationCache {
+  struct alignas(64) Line {
+    std::atomic<uint64_t> entries[8] = {};
+  };
+  static_assert(sizeof(Line) == 64);
+
+  uint64_t size = 0; // Number of entries (power of two or zero for disabled)
+  std::unique_ptr<Line[]> data;
+
+  // Stats
+  int64_t num_probes = 0;
+  int64_t num_hits = 0;
+
+  void reset() {
+    for (uint64_t i = 0; i < size; i++) { getEntry(i).store(0, std::memory_order_relaxed); }
+    resetStats();
+  }
+
+  void resetStats() { num_probes = num_hits = 0; }
+
+  void resizeMB(uint64_t mb) {
+    uint64_t num_lines = (mb << 20) / sizeof(Line);
+    while (num_lines & (num_lines - 1)) { num_lines &= num_lines - 1; } // Floor to power of two
+    size = num_lines * 8;
+    data.reset(num_lines > 0 ? new Line[num_lines] : nullptr);
+    resetStats();
+  }
+
+  std::atomic<uint64_t>& getEntry(uint64_t key) {
+    uint64_t index = key & (size - 1);
+    return data[index / 8].entries[index % 8];
+  }
+
+  bool get(uint64_t key, Score& score) {
+    if (size == 0) { return false; }
+    num_probes++;
+    uint64_t entry = getEntry(key).load(std::memory_order_relaxed);
+    if ((entry >> 16) != (key >> 16)) { return false; }
+    num_hits++;
+    score = static_cast<Score>(entry & 0xffff);
+    return true;
+  }
+
+  void put(uint64_t key, Score score) {
+    if (size == 0) { return; }
+    uint64_t entry = ((key >> 16) << 16) | static_cast<uint16_t>(score);
+    getEntry(key).store(entry, std::memory_order_relaxed);
+  }
+
+  double getHitRate() const { return num_probes > 0 ? double(num_hits) / num_probes : 0; }
+};
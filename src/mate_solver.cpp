@@ -0,0 +1,140 @@
+#include "mate_solver.hpp"
+#include "position.hpp"
+
+MateSolver::MateSolver(Position& position_, int table_size_mb) : position{position_} {
+  // Power of 2 entries
+  size_t size = 1;
+  while (2 * size * sizeof(Entry) <= ((size_t)table_size_mb << 20)) { size *= 2; }
+  table.assign(size, {});
+}
+
+MateSolver::Result MateSolver::solve(int64_t max_nodes_, int max_ply_) {
+  max_nodes = max_nodes_;
+  max_ply = max_ply_ > 0 ? max_ply_ : &position.state_stack.back() - position.state - 1;
+  num_nodes = 0;
+  attacker = position.side_to_move;
+  std::fill(table.begin(), table.end(), Entry{});
+
+  searchImpl(kInfinity, kInfinity, 0);
+
+  Result result;
+  auto root = lookup(position.state->key);
+  result.status = root.pn == 0 ? kProven : root.dn == 0 ? kDisproven : kUnknown;
+  if (result.status == kProven) { result.pv = getPV(); }
+  result.nodes = num_nodes;
+  return result;
+}
+
+void MateSolver::searchImpl(uint32_t threshold_pn, uint32_t threshold_dn, int ply) {
+  num_nodes++;
+  Key key = position.state->key;
+  bool or_node = position.side_to_move == attacker; // Attacker to move
+
+  // Draw or too deep (not at root which needs a move)
+  if (ply > 0 && (position.isDraw() || ply >= max_ply)) {
+    store({key, kInfinity, 0});
+    return;
+  }
+
+  // Children are checks of attacker or all evasions of defender (keys are saved to look up table without making move)
+  struct Child { Move move; Key key; };
+  SimpleQueue<Child, 256> children;
+  MoveList moves;
+  position.generateMoves(moves);
+  for (auto move : moves) {
+    if (!position.isLegal(move)) { continue; }
+    position.makeMove(move, /* temporary */ true);
+    bool check = position.state->checkers;
+    Key child_key = position.state->key;
+    position.unmakeMove(move, /* temporary */ true);
+    if (or_node && !check) { continue; }
+    children.put({move, child_key});
+  }
+
+  // No check (attacker) or checkmate (defender)
+  if (children.empty()) {
+    bool mated = !or_node && position.state->checkers;
+    store(mated ? Entry{key, 0, kInfinity, 0} : Entry{key, kInfinity, 0});
+    return;
+  }
+
+  while (true) {
+    // Aggregate children
+    // - OR node : pn = min(pn), dn = sum(dn)
+    // - AND node: pn = sum(pn), dn = min(dn)
+    // (i.e. OR node is proven by any child and AND node by all children)
+    Entry entry{key, 0, 0};
+    uint32_t min_value = kInfinity, second_value = kInfinity;
+    int best = 0;
+    uint32_t distance = or_node ? UINT32_MAX : 0;
+    for (int i = 0; i < (int)children.size(); i++) {
+      auto child = lookup(children[i].key);
+      uint32_t value = or_node ? child.pn : child.dn; // Minimized
+      uint32_t other = or_node ? child.dn : child.pn; // Summed
+      if (value < min_value) {
+        second_value = min_value;
+        min_value = value;
+        best = i;
+      } else if (value < second_value) {
+        second_value = value;
+      }
+      (or_node ? entry.dn : entry.pn) = std::min(kInfinity - 1, (or_node ? entry.dn : entry.pn) + other); // Infinity is only for proof/disproof
+      if (child.pn == 0) { distance = or_node ? std::min(distance, child.distance) : std::max(distance, child.distance); }
+    }
+    (or_node ? entry.pn : entry.dn) = min_value;
+    if (entry.pn == 0) { entry.dn = kInfinity; entry.distance = distance + 1; }
+    if (entry.dn == 0) { entry.pn = kInfinity; }
+
+    if (entry.pn >= threshold_pn || entry.dn >= threshold_dn || (max_nodes && num_nodes >= max_nodes)) {
+      store(entry);
+      return;
+    }
+
+    // Search most proving child with thresholds so that it returns when the second best one becomes better
+    auto child = lookup(children[best].key);
+    uint32_t child_threshold_pn, child_threshold_dn;
+    if (or_node) {
+      child_threshold_pn = std::min(threshold_pn, second_value + 1);
+      child_threshold_dn = std::min<uint64_t>(kInfinity, (uint64_t)threshold_dn - entry.dn + child.dn);
+    } else {
+      child_threshold_pn = std::min<uint64_t>(kInfinity, (uint64_t)threshold_pn - entry.pn + child.pn);
+      child_threshold_dn = std::min(threshold_dn, second_value + 1);
+    }
+    auto move = children[best].move;
+    position.makeMove(move, /* temporary */ true);
+    searchImpl(child_threshold_pn, child_threshold_dn, ply + 1);
+    position.unmakeMove(move, /* temporary */ true);
+  }
+}
+
+MoveList MateSolver::getPV() {
+  // Follow shortest mate for attacker and longest defence for defender
+  MoveList pv;
+  while (true) {
+    bool or_node = position.side_to_move == attacker;
+    auto entry = lookup(position.state->key);
+    if (entry.pn != 0 || entry.distance == 0 || (int)pv.size() >= max_ply) { break; }
+
+    MoveList moves;
+    position.generateMoves(moves);
+    Move best_move = kNoneMove;
+    uint32_t best_distance = 0;
+    for (auto move : moves) {
+      if (!position.isLegal(move)) { continue; }
+      position.makeMove(move, /* temporary */ true);
+      auto child = lookup(position.state->key);
+      bool valid = child.pn == 0 && (!or_node || position.state->checkers);
+      position.unmakeMove(move, /* temporary */ true);
+      if (!valid) { continue; }
+      if (best_move == kNoneMove || (or_node ? child.distance < best_distance : child.distance > best_distance)) {
+        best_move = move;
+        best_distance = child.distance;
+      }
+    }
+    if (best_move == kNoneMove) { break; } // Overwritten in table
+    pv.put(best_move);
+    position.makeMove(best_move, /* temporary */ true);
+  }
+  for (int i = pv.size() - 1; i >= 0; i--) { position.unmakeMove(pv[i], /* temporary */ true); }
+  return pv;
+}
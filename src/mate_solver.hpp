@@ -0,0 +1,58 @@
+#pragma once
+
+#include "base.hpp"
+#include "move.hpp"
+#include "position_fwd.hpp"
+
+//
+// Forced mate solver by depth-first proof-number search (df-pn)
+//
+// - Attacker (side to move at root) plays only checks and defender plays all legal evasions,
+//   so that neither evaluation nor depth iteration is needed.
+// - Proof/disproof numbers are kept for attacker in its own hash table (always replaced).
+// - Draw by repetition/50-move rule and the ply limit count as disproof. Such path-dependent results
+//   are stored as usual (i.e. graph history interaction is ignored), which might rarely miss a mate.
+// - Proven mate is not necessarily the shortest.
+//
+
+struct MateSolver {
+  using Key = uint64_t;
+  static inline constexpr uint32_t kInfinity = 1 << 30;
+
+  struct Entry {
+    Key key = 0;
+    uint32_t pn = 1; // Proof number (0 if mate is proven)
+    uint32_t dn = 1; // Disproof number (0 if no mate)
+    uint32_t distance = 0; // Plies to mate when proven
+  };
+  static_assert(sizeof(Entry) == 24);
+
+  enum Status { kProven, kDisproven, kUnknown };
+
+  struct Result {
+    Status status = kUnknown;
+    MoveList pv; // Mating line when proven
+    int64_t nodes = 0;
+  };
+
+  Position& position;
+  vector<Entry> table;
+  Color attacker;
+  int max_ply = 0; // Relative to root
+  int64_t max_nodes = 0; // No limit if 0
+  int64_t num_nodes = 0;
+
+  MateSolver(Position& position, int table_size_mb = 16);
+
+  // Solve from current position (which is kept as is). Ply is limited by position's stack if 0.
+  Result solve(int64_t max_nodes = 0, int max_ply = 0);
+
+  // Internal
+  Entry lookup(Key key) const {
+    auto& entry = table[key & (table.size() - 1)];
+    return entry.key == key ? entry : Entry{key};
+  }
+  void store(const Entry& entry) { table[entry.key & (table.size() - 1)] = entry; }
+  void searchImpl(uint32_t threshold_pn, uint32_t threshold_dn, int ply);
+  MoveList getPV();
+};
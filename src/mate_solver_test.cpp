@@ -0,0 +1,52 @@
+#include "mate_solver.hpp"
+#include "position.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+// Play moves and check the line ends with checkmate by attacker
+static bool isMatingLine(Position pos, const MoveList& pv) {
+  if (pv.size() % 2 == 0) { return false; }
+  for (int i = 0; i < (int)pv.size(); i++) {
+    if (!pos.isPseudoLegal(pv[i]) || !pos.isLegal(pv[i])) { return false; }
+    pos.makeMove(pv[i]);
+    if (i % 2 == 0 && !pos.state->checkers) { return false; } // Only checks by attacker
+  }
+  MoveList moves;
+  pos.generateMoves(moves);
+  return std::none_of(moves.begin(), moves.end(), [&](auto move) { return pos.isLegal(move); });
+}
+
+TEST_CASE("MateSolver") {
+  Position pos;
+  MateSolver solver(pos, /* table_size_mb */ 1);
+
+  // Mate in 3
+  pos.initialize("8/8/2k5/7R/6R1/4K3/8/8 w - - 0 1");
+  auto key = pos.state->key;
+  auto result = solver.solve();
+  CHECK(result.status == MateSolver::kProven);
+  CHECK(toString(result.pv) == "{g4g6, c6b7, h5h7, b7a8, g6g8}");
+  CHECK(pos.state == &pos.state_stack[0]);
+  CHECK(pos.state->key == key);
+
+  // Mate in 8 with black
+  pos.initialize("r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1");
+  result = solver.solve();
+  CHECK(result.status == MateSolver::kProven);
+  CHECK(result.pv.size() == 15);
+  CHECK(isMatingLine(pos, result.pv));
+
+  // Node limit
+  result = solver.solve(/* max_nodes */ 10);
+  CHECK(result.status == MateSolver::kUnknown);
+  CHECK(result.nodes == 10);
+
+  // No check
+  pos.initialize(kFenInitialPosition);
+  result = solver.solve();
+  CHECK(result.status == MateSolver::kDisproven);
+  CHECK(result.pv.empty());
+
+  // Checks run out
+  pos.initialize("k7/8/8/8/8/8/8/KR6 w - - 0 1");
+  CHECK(solver.solve().status == MateSolver::kDisproven);
+}
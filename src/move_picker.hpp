@@ -61,7 +61,14 @@ struct MovePicker {
     }
   }
 
+  // Prefetch evaluator's rows of the move for search to make it soon
   bool getNext(Move& res_move) {
+    if (!getNextImpl(res_move)) { return false; }
+    position.prefetchEvaluation(res_move);
+    return true;
+  }
+
+  bool getNextImpl(Move& res_move) {
     tmp_list.clear();
 
     //
@@ -1,14 +1,18 @@
+import weight_file
 
 
 def main(infile):
   with open(infile, 'rb') as f:
     data = f.read()
+  if weight_file.is_legacy(data):
+    data = weight_file.convert_legacy(data)
   size = len(data)
   data_literal = ('+' + data.hex('+')).replace('+', '\\x')
   print("namespace nn {")
   print("  extern const char* kEmbeddedWeight;")
   print("  extern const int kEmbeddedWeightSize;")
-  print("  const char* kEmbeddedWeight = \"", data_literal, "\";", sep="")
+  print(f"  alignas({weight_file.ALIGNMENT}) const char kEmbeddedWeightData[] = \"", data_literal, "\";", sep="")
+  print("  const char* kEmbeddedWeight = kEmbeddedWeightData;")
   print("  const int kEmbeddedWeightSize = ", size, ";", sep="")
   print("}")
 
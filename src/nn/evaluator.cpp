@@ -3,48 +3,98 @@
 
 namespace nn {
 
-Score Evaluator::evaluate() {
-  relu<2 * WIDTH2>(accumulator[0], tmp2);
-  model.l2->forward(tmp2, tmp3);
-  relu<WIDTH3>(tmp3, tmp3);
-  model.l3->forward(tmp3, tmp4);
+template<typename A>
+Score EvaluatorImpl<A>::evaluate() {
+  // NOTE: relu is fused into l2 and l3 (accumulator[0] and accumulator[1] are contiguous)
+  model->l2.forward(accumulator[0], tmp3);
+  model->l3.forward(tmp3, tmp4);
   relu<WIDTH4>(tmp4, tmp4);
-  model.l4->forward(tmp4, &tmp5);
-  Score score = std::round(tmp5 * 100);
-  return std::clamp<Score>(score, -kScoreWin, kScoreWin);
+  model->l4.forward(tmp4, &tmp5);
+  return toScore(tmp5);
 }
 
-void Evaluator::initialize(const Position& pos) {
-  copy<WIDTH2>(model.l1->bias, accumulator[0]);
-  copy<WIDTH2>(model.l1->bias, accumulator[1]);
+template<typename A>
+void EvaluatorImpl<A>::evaluate(const Accumulator<A> inputs[], int batch_size, Score outputs[]) {
+  // Process by chunk so that hidden states stay on L1
+  constexpr int kChunkSize = 16;
+  alignas(kMaxFloatVectorSize) float x3[kChunkSize][WIDTH3];
+  alignas(kMaxFloatVectorSize) float x4[kChunkSize][WIDTH4];
+  for (int k = 0; k < batch_size; k += kChunkSize) {
+    int n = std::min(kChunkSize, batch_size - k);
+    auto x2 = reinterpret_cast<const float(*)[2 * WIDTH2]>(inputs[k].data[0]);
+    reluAffineBatch<2 * WIDTH2, WIDTH3>(model->l2.weight, x2, n, model->l2.bias, x3);
+    reluAffineBatch<WIDTH3, WIDTH4>(model->l3.weight, x3, n, model->l3.bias, x4);
+    for (int i = 0; i < n; i++) {
+      float y = 0;
+      relu<WIDTH4>(x4[i], x4[i]);
+      model->l4.forward(x4[i], &y);
+      outputs[k + i] = toScore(y);
+    }
+  }
+}
+
+template<typename A>
+array<int, 2> EvaluatorImpl<A>::getKeys(const Position& pos) {
+  using F = typename A::Features;
+  return {F::getKey(kWhite, pos.kingSQ(kWhite)), F::getKey(kBlack, pos.kingSQ(kBlack))};
+}
 
-  kings[0] = pos.kingSQ(kWhite);
-  kings[1] = SQ::flipRank(pos.kingSQ(kBlack));
+template<typename A>
+void EvaluatorImpl<A>::initialize(const Position& pos) {
+  num_added = num_removed = {};
+  keys = getKeys(pos);
+  initialize(pos, accumulator);
+}
 
+template<typename A>
+void EvaluatorImpl<A>::initialize(const Position& pos, float output[2][WIDTH2]) const {
+  // Accumulate all pieces on top of bias
+  auto pos_keys = getKeys(pos);
+  array2<const float*, 2, 32> rows;
+  array<int, 2> num_rows = {};
   for (Color color = 0; color < 2; color++) {
-    for (PieceType type = 0; type < 5; type++) {
+    for (PieceType type = 0; type < 6; type++) {
       for (auto sq : toSQ(pos.pieces[color][type])) {
-        putPiece(color, type, sq);
+        auto indices = getIndices(pos_keys, color, type, sq);
+        for (int i = 0; i < 2; i++) {
+          if (indices[i] < 0) { continue; }
+          ASSERT_HOT(num_rows[i] < 32);
+          rows[i][num_rows[i]++] = model->l1.weight[indices[i]];
+        }
       }
     }
   }
+  accumulate<WIDTH2>(model->l1.bias, rows[0].data(), num_rows[0], nullptr, 0, output[0]);
+  accumulate<WIDTH2>(model->l1.bias, rows[1].data(), num_rows[1], nullptr, 0, output[1]);
+}
+
+template<typename A>
+void EvaluatorImpl<A>::update() {
+  accumulate<WIDTH2>(accumulator[0], added[0].data(), num_added[0], removed[0].data(), num_removed[0], accumulator[0]);
+  accumulate<WIDTH2>(accumulator[1], added[1].data(), num_added[1], removed[1].data(), num_removed[1], accumulator[1]);
+  num_added = num_removed = {};
 }
 
-void Evaluator::update(Color color, PieceType type, Square sq, bool put) {
-  if (type == kKing) { return; }
-  int type_w = type + 5 * (color == 1);
-  int type_b = type + 5 * (color == 0);
-  int sq_w = sq;
-  int sq_b = SQ::flipRank(sq);
-  int index_w = (type_w * 64 + sq_w) * 64 + kings[0];
-  int index_b = (type_b * 64 + sq_b) * 64 + kings[1];
-  if (put) {
-    add<WIDTH2>(accumulator[0], model.l1->weight[index_w], accumulator[0]);
-    add<WIDTH2>(accumulator[1], model.l1->weight[index_b], accumulator[1]);
-  } else {
-    sub<WIDTH2>(accumulator[0], model.l1->weight[index_w], accumulator[0]);
-    sub<WIDTH2>(accumulator[1], model.l1->weight[index_b], accumulator[1]);
+template<typename A>
+void EvaluatorImpl<A>::update(Color color, PieceType type, Square sq, bool put) {
+  auto indices = getIndices(color, type, sq);
+  for (int i = 0; i < 2; i++) {
+    if (indices[i] < 0) { continue; }
+    if (put) {
+      add<WIDTH2>(accumulator[i], model->l1.weight[indices[i]], accumulator[i]);
+    } else {
+      sub<WIDTH2>(accumulator[i], model->l1.weight[indices[i]], accumulator[i]);
+    }
   }
 }
 
+// Explicit instantiation
+template struct EvaluatorImpl<DefaultArchitecture>;
+template struct EvaluatorImpl<Architecture<HalfKP, 256, 32, 32>>;
+template struct EvaluatorImpl<Architecture<HalfKP,  64, 32, 32>>;
+template struct EvaluatorImpl<Architecture<HalfKA, 128, 32, 32>>;
+template struct EvaluatorImpl<Architecture<HalfKA, 256, 32, 32>>;
+template struct EvaluatorImpl<Architecture<HalfKP,  32, 32, 32>>;
+template struct EvaluatorImpl<Architecture<HalfKA,  32, 32, 32>>;
+
 }; // namespace nn
@@ -5,82 +5,218 @@
 #include "../position_fwd.hpp"
 #include "utils.hpp"
 #include "embedded_weight.hpp"
+#include "weight_file.hpp"
+#include "feature_set.hpp"
 
 namespace nn {
 
-// Constants from main.py
-inline constexpr int WIDTH1 = 10 * 64 * 64;
-inline constexpr int WIDTH2 = 128;
-inline constexpr int WIDTH3 = 32;
-inline constexpr int WIDTH4 = 32;
-
-struct MyModel {
-
-  // NOTE: Allocate on heap since weights are too large for stack
-  std::unique_ptr<InputLayer<WIDTH1, WIDTH2>> l1;
-  std::unique_ptr<Linear<2 * WIDTH2, WIDTH3>> l2;
-  std::unique_ptr<Linear<    WIDTH3, WIDTH4>> l3;
-  std::unique_ptr<Linear<    WIDTH4,      1>> l4;
-
-  MyModel() {
-    l1.reset(new decltype(l1)::element_type);
-    l2.reset(new decltype(l2)::element_type);
-    l3.reset(new decltype(l3)::element_type);
-    l4.reset(new decltype(l4)::element_type);
+// Network shape over input feature set (WIDTH1..WIDTH4 as in main.py)
+template<typename F, int W2, int W3, int W4>
+struct Architecture {
+  using Features = F;
+  static inline constexpr int WIDTH1 = F::kWidth;
+  static inline constexpr int WIDTH2 = W2;
+  static inline constexpr int WIDTH3 = W3;
+  static inline constexpr int WIDTH4 = W4;
+
+  static bool match(const WeightFile::Header& header) {
+    return header.feature_set == F::kType && header.num_layers == 4 &&
+           header.dims[0] == WIDTH1 && header.dims[1] == WIDTH2 && header.dims[2] == WIDTH3 &&
+           header.dims[3] == WIDTH4 && header.dims[4] == 1;
   }
 
-  void load(const string& filename) {
-    std::ifstream istr(filename, std::ios_base::in | std::ios_base::binary);
-    ASSERT(istr);
-    load(istr);
-    istr.peek();
-    ASSERT(istr.eof());
-  }
+  static string name() { return string(F::kName) + "-" + std::to_string(WIDTH2) + "x" + std::to_string(WIDTH3) + "x" + std::to_string(WIDTH4); }
+};
 
-  void load(std::istream& istr) {
-    l1->load(istr);
-    l2->load(istr);
-    l3->load(istr);
-    l4->load(istr);
+// Embedded weight's architecture
+using DefaultArchitecture = Architecture<HalfKP, 128, 32, 32>;
+
+// Immutable weights shared by all evaluators (cf. Model::fromFile, Model::fromEmbeddedWeight)
+template<typename Arch>
+struct Model {
+  static inline constexpr int WIDTH1 = Arch::WIDTH1, WIDTH2 = Arch::WIDTH2, WIDTH3 = Arch::WIDTH3, WIDTH4 = Arch::WIDTH4;
+
+  // Layers are views into weight file (mmap-ed file is shared via page cache between processes)
+  std::shared_ptr<const WeightFile> file;
+  InputLayer<WIDTH1, WIDTH2> l1;
+  SparseLinear<2 * WIDTH2, WIDTH3> l2;
+  SparseLinear<    WIDTH3, WIDTH4> l3;
+  Linear<    WIDTH4,      1> l4; // NOTE: [in][1] coincides with [1][in]
+
+  void load(const std::shared_ptr<const WeightFile>& weight_file) {
+    ASSERT(Arch::match(weight_file->header()));
+    file = weight_file;
+    std::apply([&](auto&&... args) { l1.load(args...); }, file->getLayer(0));
+    std::apply([&](auto&&... args) { l2.load(args...); }, file->getLayer(1));
+    std::apply([&](auto&&... args) { l3.load(args...); }, file->getLayer(2));
+    std::apply([&](auto&&... args) { l4.load(args...); }, file->getLayer(3));
   }
 
-  void loadEmbeddedWeight() {
-    // NOTE: Make istream from char array (Cf. https://stackoverflow.com/questions/7781898/get-an-istream-from-a-char)
-    struct CharStreambuf : std::streambuf {
-      CharStreambuf(char* ptr, int size) { setg(ptr, ptr, ptr + size); }
-    };
-    CharStreambuf buf(const_cast<char*>(kEmbeddedWeight), kEmbeddedWeightSize);
+  static std::shared_ptr<const Model> fromWeightFile(const std::shared_ptr<const WeightFile>& weight_file) {
+    auto model = std::make_shared<Model>();
+    model->load(weight_file);
+    return model;
+  }
 
-    std::istream istr(&buf);
-    load(istr);
+  // nullptr if file is invalid
+  static std::shared_ptr<const Model> fromFile(const string& filename) {
+    auto file = WeightFile::fromFile(filename);
+    return file ? fromWeightFile(file) : nullptr;
+  }
 
-    istr.peek();
-    ASSERT(istr.eof());
+  // Loaded only once per process
+  static std::shared_ptr<const Model> fromEmbeddedWeight() {
+    static std::shared_ptr<const Model> embedded = []() {
+      auto file = WeightFile::fromMemory(kEmbeddedWeight, kEmbeddedWeightSize);
+      ASSERT(file);
+      return fromWeightFile(file);
+    }();
+    return embedded;
   }
 };
 
-struct Evaluator {
-  MyModel model;
+// Accumulator of a single position for batched evaluation
+template<typename Arch>
+struct alignas(kMaxFloatVectorSize) Accumulator {
+  float data[2][Arch::WIDTH2] = {};
+};
+
+// Per-thread accumulator/scratch state for fixed architecture
+template<typename A>
+struct EvaluatorImpl {
+  using Arch = A;
+  static inline constexpr int WIDTH1 = Arch::WIDTH1, WIDTH2 = Arch::WIDTH2, WIDTH3 = Arch::WIDTH3, WIDTH4 = Arch::WIDTH4;
+  static_assert(sizeof(Accumulator<Arch>) == sizeof(float) * 2 * WIDTH2); // Contiguous as batch
+
+  std::shared_ptr<const Model<Arch>> model;
 
   alignas(kMaxFloatVectorSize) float accumulator[2][WIDTH2] = {};
-  alignas(kMaxFloatVectorSize) float tmp2[2 * WIDTH2] = {};
   alignas(kMaxFloatVectorSize) float tmp3[WIDTH3] = {};
   alignas(kMaxFloatVectorSize) float tmp4[WIDTH4] = {};
   float tmp5 = 0;
 
-  array<Square, 2> kings;
+  // Feature set's per-perspective state (e.g. king bucket)
+  array<int, 2> keys;
+
+  // Feature rows added/removed by a single move (for white/black perspective)
+  static inline constexpr int kMaxDelta = 4;
+  array2<const float*, 2, kMaxDelta> added = {}, removed = {};
+  array<int, 2> num_added = {}, num_removed = {};
 
-  void load(const string& filename) { model.load(filename); }
-  void loadEmbeddedWeight() { model.loadEmbeddedWeight(); }
+  // Prefetch rows as soon as they are known (cf. Position::prefetchEvaluation)
+  bool use_prefetch = true;
+
+  bool load(const string& filename) {
+    auto file = WeightFile::fromFile(filename);
+    if (!file || !Arch::match(file->header())) { return false; }
+    model = Model<Arch>::fromWeightFile(file);
+    return true;
+  }
+  void loadEmbeddedWeight() { model = Model<Arch>::fromEmbeddedWeight(); }
 
   Score evaluate();
 
   void initialize(const Position&);
 
-  // Incremental update
+  // Batched evaluation (e.g. for offline dataset relabeling), which doesn't touch incremental states
+  void initialize(const Position&, float[2][WIDTH2]) const;
+  void initialize(const Position& pos, Accumulator<Arch>& output) const { initialize(pos, output.data); }
+  void evaluate(const Accumulator<Arch> inputs[], int batch_size, Score outputs[]);
+
+  static Score toScore(float value) {
+    Score score = std::round(value * 100);
+    return std::clamp<Score>(score, -kScoreWin, kScoreWin);
+  }
+
+  static array<int, 2> getKeys(const Position&);
+
+  static array<int, 2> getIndices(const array<int, 2>& keys, Color color, PieceType type, Square sq) {
+    using F = typename Arch::Features;
+    return {F::getIndex(kWhite, keys[0], color, type, sq), F::getIndex(kBlack, keys[1], color, type, sq)};
+  }
+
+  array<int, 2> getIndices(Color color, PieceType type, Square sq) const { return getIndices(keys, color, type, sq); }
+
+  // Incremental update of single feature
   void update(Color, PieceType, Square, bool);
-  void putPiece(Color color, PieceType type, Square to) { update(color, type, to, true); }
-  void removePiece(Color color, PieceType type, Square from) { update(color, type, from, false); }
+
+  // Incremental update of all pending features at once
+  void update();
+
+  // Apply pending features or refresh if keys are changed by king move (cf. Position::makeMove)
+  void update(const Position& pos) {
+    if (getKeys(pos) == keys) { update(); } else { initialize(pos); }
+  }
+
+  void putPiece(Color color, PieceType type, Square to) {
+    auto indices = getIndices(color, type, to);
+    for (int i = 0; i < 2; i++) {
+      if (indices[i] < 0) { continue; }
+      ASSERT_HOT(num_added[i] < kMaxDelta);
+      auto row = added[i][num_added[i]++] = model->l1.weight[indices[i]];
+      if (use_prefetch) { nn::prefetch<WIDTH2>(row); }
+    }
+  }
+
+  void removePiece(Color color, PieceType type, Square from) {
+    auto indices = getIndices(color, type, from);
+    for (int i = 0; i < 2; i++) {
+      if (indices[i] < 0) { continue; }
+      ASSERT_HOT(num_removed[i] < kMaxDelta);
+      auto row = removed[i][num_removed[i]++] = model->l1.weight[indices[i]];
+      if (use_prefetch) { nn::prefetch<WIDTH2>(row); }
+    }
+  }
+
+  void prefetch(Color color, PieceType type, Square sq) const {
+    if (!use_prefetch) { return; }
+    auto indices = getIndices(color, type, sq);
+    for (int i = 0; i < 2; i++) {
+      if (indices[i] >= 0) { nn::prefetch<WIDTH2>(model->l1.weight[indices[i]]); }
+    }
+  }
+};
+
+// Evaluator whose architecture is selected at load time from weight file header
+struct Evaluator {
+  // Architectures supported by a single binary (see Architecture::name for the naming)
+  std::variant<
+    EvaluatorImpl<DefaultArchitecture>,
+    EvaluatorImpl<Architecture<HalfKP, 256, 32, 32>>,
+    EvaluatorImpl<Architecture<HalfKP,  64, 32, 32>>,
+    EvaluatorImpl<Architecture<HalfKA, 128, 32, 32>>,
+    EvaluatorImpl<Architecture<HalfKA, 256, 32, 32>>,
+    EvaluatorImpl<Architecture<HalfKP,  32, 32, 32>>, // Small networks (cf. Engine::evaluate)
+    EvaluatorImpl<Architecture<HalfKA,  32, 32, 32>>> impl;
+
+  // False if file is invalid or no architecture matches (then evaluator is unchanged)
+  bool load(const std::shared_ptr<const WeightFile>& file) { return file && loadImpl<0>(file); }
+  bool load(const string& filename) { return load(WeightFile::fromFile(filename)); }
+  void loadEmbeddedWeight() { impl.emplace<0>().loadEmbeddedWeight(); }
+
+  template<size_t I>
+  bool loadImpl(const std::shared_ptr<const WeightFile>& file) {
+    if constexpr (I == std::variant_size_v<decltype(impl)>) {
+      return false;
+    } else {
+      using Impl = std::variant_alternative_t<I, decltype(impl)>;
+      using Arch = typename Impl::Arch;
+      if (!Arch::match(file->header())) { return loadImpl<I + 1>(file); }
+      impl.emplace<I>().model = Model<Arch>::fromWeightFile(file);
+      return true;
+    }
+  }
+
+  string architecture() const { return std::visit([](auto& e) { return std::decay_t<decltype(e)>::Arch::name(); }, impl); }
+
+  Score evaluate() { return std::visit([](auto& e) { return e.evaluate(); }, impl); }
+  void initialize(const Position& pos) { std::visit([&](auto& e) { e.initialize(pos); }, impl); }
+  void update() { std::visit([](auto& e) { e.update(); }, impl); }
+  void update(const Position& pos) { std::visit([&](auto& e) { e.update(pos); }, impl); }
+  void putPiece(Color color, PieceType type, Square to) { std::visit([&](auto& e) { e.putPiece(color, type, to); }, impl); }
+  void removePiece(Color color, PieceType type, Square from) { std::visit([&](auto& e) { e.removePiece(color, type, from); }, impl); }
+  void prefetch(Color color, PieceType type, Square sq) const { std::visit([&](auto& e) { e.prefetch(color, type, sq); }, impl); }
+  void setPrefetch(bool value) { std::visit([&](auto& e) { e.use_prefetch = value; }, impl); }
 };
 
 }; // namespace nn
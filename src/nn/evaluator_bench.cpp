@@ -3,8 +3,10 @@
 #include "../timeit.hpp"
 #include <catch2/catch_test_macros.hpp>
 
+using Arch = nn::DefaultArchitecture;
+
 TEST_CASE("nn::Evaluator") {
-  nn::Evaluator evaluator;
+  nn::EvaluatorImpl<Arch> evaluator;
   evaluator.loadEmbeddedWeight();
 
   Position pos;
@@ -20,8 +22,43 @@ TEST_CASE("nn::Evaluator") {
 
   SECTION("update") {
     INFO(timeit::timeit([&]() {
-      evaluator.update(kWhite, kPawn, kE2, -1);
-      evaluator.update(kWhite, kPawn, kE4, +1);
+      evaluator.update(kWhite, kPawn, kE2, false);
+      evaluator.update(kWhite, kPawn, kE4, true);
+      return evaluator.accumulator[0][0];
+    }));
+    SUCCEED();
+  }
+
+  SECTION("update (fused)") {
+    INFO(timeit::timeit([&]() {
+      evaluator.removePiece(kWhite, kPawn, kE2);
+      evaluator.putPiece(kWhite, kPawn, kE4);
+      evaluator.update();
+      return evaluator.accumulator[0][0];
+    }));
+    SUCCEED();
+  }
+
+  SECTION("update (fused, dispatch)") {
+    // Same as above via architecture dispatch of nn::Evaluator
+    nn::Evaluator dispatcher;
+    dispatcher.loadEmbeddedWeight();
+    dispatcher.initialize(pos);
+    INFO(timeit::timeit([&]() {
+      dispatcher.removePiece(kWhite, kPawn, kE2);
+      dispatcher.putPiece(kWhite, kPawn, kE4);
+      dispatcher.update();
+      return std::get<0>(dispatcher.impl).accumulator[0][0];
+    }));
+    SUCCEED();
+  }
+
+  SECTION("update (fused capture)") {
+    INFO(timeit::timeit([&]() {
+      evaluator.removePiece(kWhite, kPawn, kE4);
+      evaluator.removePiece(kBlack, kPawn, kD5);
+      evaluator.putPiece(kWhite, kPawn, kD5);
+      evaluator.update();
       return evaluator.accumulator[0][0];
     }));
     SUCCEED();
@@ -33,4 +70,141 @@ TEST_CASE("nn::Evaluator") {
     }));
     SUCCEED();
   }
+
+  SECTION("evaluate (dense)") {
+    // Non-fused relu and affine with untransposed weights
+    auto& model = evaluator.model;
+    struct alignas(nn::kMaxFloatVectorSize) DenseWeight {
+      float w2[Arch::WIDTH3][2 * Arch::WIDTH2];
+      float w3[Arch::WIDTH4][Arch::WIDTH3];
+    };
+    auto dense = std::make_unique<DenseWeight>();
+    for (int i = 0; i < Arch::WIDTH3; i++) {
+      for (int j = 0; j < 2 * Arch::WIDTH2; j++) { dense->w2[i][j] = model->l2.weight[j][i]; }
+    }
+    for (int i = 0; i < Arch::WIDTH4; i++) {
+      for (int j = 0; j < Arch::WIDTH3; j++) { dense->w3[i][j] = model->l3.weight[j][i]; }
+    }
+    nn::Linear<2 * Arch::WIDTH2, Arch::WIDTH3> l2;
+    nn::Linear<Arch::WIDTH3, Arch::WIDTH4> l3;
+    l2.load(dense->w2[0], model->l2.bias);
+    l3.load(dense->w3[0], model->l3.bias);
+    alignas(nn::kMaxFloatVectorSize) float tmp2[2 * Arch::WIDTH2], tmp3[Arch::WIDTH3], tmp4[Arch::WIDTH4];
+    float tmp5;
+    INFO(timeit::timeit([&]() {
+      nn::relu<2 * Arch::WIDTH2>(evaluator.accumulator[0], tmp2);
+      l2.forward(tmp2, tmp3);
+      nn::relu<Arch::WIDTH3>(tmp3, tmp3);
+      l3.forward(tmp3, tmp4);
+      nn::relu<Arch::WIDTH4>(tmp4, tmp4);
+      model->l4.forward(tmp4, &tmp5);
+      return tmp5;
+    }));
+    SUCCEED();
+  }
+}
+
+TEST_CASE("nn::Evaluator::evaluate (batch)") {
+  nn::EvaluatorImpl<Arch> evaluator;
+  evaluator.loadEmbeddedWeight();
+
+  // Positions along random game
+  const int kMaxBatchSize = 256;
+  vector<nn::Accumulator<Arch>> inputs(kMaxBatchSize);
+  vector<Score> outputs(kMaxBatchSize);
+  Position pos;
+  Rng rng;
+  for (int i = 0; i < kMaxBatchSize; i++) {
+    evaluator.initialize(pos, inputs[i]);
+    MoveList moves;
+    pos.generateMoves(moves);
+    vector<Move> legal_moves;
+    for (auto move : moves) { if (pos.isLegal(move)) { legal_moves.push_back(move); } }
+    if (legal_moves.empty() || i % 64 == 63) { pos.initialize(kFenInitialPosition); continue; }
+    pos.makeMove(legal_moves[rng.next() % legal_moves.size()]);
+  }
+
+  for (int batch_size : {1, 8, 64, 256}) {
+    SECTION("batch-" + std::to_string(batch_size)) {
+      auto result = timeit::run([&]() {
+        evaluator.evaluate(inputs.data(), batch_size, outputs.data());
+        return outputs[0];
+      });
+      auto mean = std::get<0>(result);
+      INFO(toString("evals/sec:", int64_t(batch_size / mean), "(" + toString(timeit::Printer{result}) + ")"));
+      SUCCEED();
+    }
+  }
+
+  SECTION("non-batch") {
+    // Same positions with single evaluation as baseline
+    auto result = timeit::run([&]() {
+      for (int i = 0; i < kMaxBatchSize; i++) {
+        std::copy_n(inputs[i].data[0], 2 * Arch::WIDTH2, evaluator.accumulator[0]);
+        outputs[i] = evaluator.evaluate();
+      }
+      return outputs[0];
+    });
+    auto mean = std::get<0>(result);
+    INFO(toString("evals/sec:", int64_t(kMaxBatchSize / mean), "(" + toString(timeit::Printer{result}) + ")"));
+    SUCCEED();
+  }
+}
+
+TEST_CASE("nn::Evaluator::update (random moves)") {
+  // Random games so that l1 rows are scattered as in search (instead of toggling a single move)
+  const int kNumGames = 64, kNumPlies = 64;
+  vector<vector<Move>> games(kNumGames);
+  Rng rng;
+  for (auto& game : games) {
+    Position pos;
+    for (int i = 0; i < kNumPlies; i++) {
+      MoveList moves;
+      pos.generateMoves(moves);
+      vector<Move> legal_moves;
+      for (auto move : moves) { if (pos.isLegal(move)) { legal_moves.push_back(move); } }
+      if (legal_moves.empty()) { break; }
+      auto move = legal_moves[rng.next() % legal_moves.size()];
+      game.push_back(move);
+      pos.makeMove(move);
+    }
+  }
+  int num_moves = 0;
+  for (auto& game : games) { num_moves += 2 * game.size(); }
+
+  nn::Evaluator evaluator;
+  evaluator.loadEmbeddedWeight();
+
+  // Make and unmake all moves of each game
+  auto run = [&](nn::Evaluator* e) {
+    Position pos;
+    pos.evaluator = e;
+    pos.reset();
+    auto result = timeit::run([&]() {
+      for (auto& game : games) {
+        for (auto move : game) { pos.prefetchEvaluation(move); pos.makeMove(move); }
+        for (int i = game.size() - 1; i >= 0; i--) { pos.unmakeMove(game[i]); }
+      }
+      return pos.state->key;
+    });
+    auto mean = std::get<0>(result);
+    return toString("nsec/move:", mean * 1e9 / num_moves, "(" + toString(timeit::Printer{result}) + ")");
+  };
+
+  SECTION("without evaluator") {
+    INFO(run(nullptr));
+    SUCCEED();
+  }
+
+  SECTION("prefetch off") {
+    evaluator.setPrefetch(false);
+    INFO(run(&evaluator));
+    SUCCEED();
+  }
+
+  SECTION("prefetch on") {
+    evaluator.setPrefetch(true);
+    INFO(run(&evaluator));
+    SUCCEED();
+  }
 }
@@ -1,7 +1,10 @@
 #include "evaluator.hpp"
 #include "../position.hpp"
+#include "../test_utils.hpp"
 #include <catch2/catch_test_macros.hpp>
 
+using DefaultEvaluator = nn::EvaluatorImpl<nn::DefaultArchitecture>;
+
 TEST_CASE("nn::Evaluator") {
   nn::Evaluator evaluator;
   evaluator.loadEmbeddedWeight();
@@ -10,3 +13,258 @@ TEST_CASE("nn::Evaluator") {
   evaluator.initialize(pos);
   CHECK(std::abs(evaluator.evaluate()) < 70);
 }
+
+TEST_CASE("nn::Evaluator::update") {
+  nn::Evaluator evaluator, expected;
+  evaluator.loadEmbeddedWeight();
+  expected.loadEmbeddedWeight();
+
+  // Capture, promotion, en passant and castling
+  auto fen = "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1";
+  Position pos(fen);
+  pos.evaluator = &evaluator;
+  pos.reset();
+
+  auto check = [&]() {
+    expected.initialize(pos);
+    auto& x = std::get<DefaultEvaluator>(evaluator.impl).accumulator;
+    auto& y = std::get<DefaultEvaluator>(expected.impl).accumulator;
+    for (int i = 0; i < 2; i++) {
+      for (int j = 0; j < DefaultEvaluator::WIDTH2; j++) {
+        if (std::abs(x[i][j] - y[i][j]) > 1e-4) { return false; }
+      }
+    }
+    return true;
+  };
+
+  vector<Move> moves = {
+    Move(kC4, kC5), Move(kD7, kD5), Move(kC5, kD6, kEnpassant), Move(kB2, kA1, kPromotion, kQueen),
+    Move(kA7, kB8, kPromotion, kKnight), Move(kE8, kG8, kCastling), Move(kD1, kA1)};
+  for (auto move : moves) {
+    pos.makeMove(move);
+    CHECK(check());
+  }
+  for (int i = moves.size() - 1; i >= 0; i--) {
+    pos.unmakeMove(moves[i]);
+    CHECK(check());
+  }
+}
+
+TEST_CASE("nn::reluAffine") {
+  constexpr int N1 = 256, N2 = 32;
+  alignas(nn::kMaxFloatVectorSize) float A[N2][N1], At[N1][N2], b[N2], x[N1], x_relu[N1], y1[N2], y2[N2];
+  Rng rng;
+  auto random = [&]() { return float(rng.next()) / float(UINT32_MAX) - 0.5f; };
+  for (int i = 0; i < N2; i++) {
+    for (int j = 0; j < N1; j++) { At[j][i] = A[i][j] = random(); }
+    b[i] = random();
+  }
+  for (int j = 0; j < N1; j++) { x[j] = random(); }
+
+  nn::relu<N1>(x, x_relu);
+  nn::affine<N1, N2>(A, x_relu, b, y1);
+  nn::reluAffine<N1, N2>(At, x, b, y2);
+  for (int i = 0; i < N2; i++) {
+    CHECK(std::abs(y1[i] - y2[i]) < 1e-4);
+  }
+}
+
+TEST_CASE("nn::Evaluator::evaluate (batch)") {
+  DefaultEvaluator evaluator;
+  evaluator.loadEmbeddedWeight();
+
+  // Positions along random game
+  const int kBatchSize = 37;
+  vector<nn::Accumulator<nn::DefaultArchitecture>> inputs(kBatchSize);
+  vector<Score> expected(kBatchSize), outputs(kBatchSize);
+  Position pos;
+  Rng rng;
+  for (int i = 0; i < kBatchSize; i++) {
+    evaluator.initialize(pos, inputs[i]);
+    evaluator.initialize(pos);
+    expected[i] = evaluator.evaluate();
+
+    MoveList moves;
+    pos.generateMoves(moves);
+    vector<Move> legal_moves;
+    for (auto move : moves) { if (pos.isLegal(move)) { legal_moves.push_back(move); } }
+    if (legal_moves.empty()) { pos.initialize(kFenInitialPosition); continue; }
+    pos.makeMove(legal_moves[rng.next() % legal_moves.size()]);
+  }
+
+  evaluator.evaluate(inputs.data(), kBatchSize, outputs.data());
+  for (int i = 0; i < kBatchSize; i++) {
+    CHECK(std::abs(outputs[i] - expected[i]) <= 1);
+  }
+}
+
+TEST_CASE("nn::Model::fromEmbeddedWeight") {
+  // Weights are shared and only accumulators are owned by each evaluator
+  nn::Evaluator evaluator1, evaluator2;
+  evaluator1.loadEmbeddedWeight();
+  evaluator2.loadEmbeddedWeight();
+  CHECK(std::get<DefaultEvaluator>(evaluator1.impl).model == std::get<DefaultEvaluator>(evaluator2.impl).model);
+  CHECK(sizeof(nn::Evaluator) < (1 << 12));
+}
+
+TEST_CASE("nn::WeightFile") {
+  auto file = nn::WeightFile::fromMemory(nn::kEmbeddedWeight, nn::kEmbeddedWeightSize);
+  CHECK(file->data == nn::kEmbeddedWeight); // Zero-copy
+  CHECK(nn::DefaultArchitecture::match(file->header()));
+  for (int i = 0; i < (int)file->header().num_layers; i++) {
+    auto [weight, bias] = file->getLayer(i);
+    CHECK(reinterpret_cast<uintptr_t>(weight) % nn::WeightFile::kAlignment == 0);
+    CHECK(reinterpret_cast<uintptr_t>(bias) % nn::WeightFile::kAlignment == 0);
+  }
+
+  SECTION("fromLegacy") {
+    // Reconstruct legacy format (pytorch's [out][in] layout) and convert it back
+    vector<float> legacy;
+    for (int i = 0; i < (int)file->header().num_layers; i++) {
+      auto [n_in, n_out] = nn::WeightFile::getLayerShape(file->header(), i);
+      auto [weight, bias] = file->getLayer(i);
+      if (i == 0) {
+        legacy.insert(legacy.end(), weight, weight + n_in * n_out);
+      } else {
+        for (size_t j = 0; j < n_out; j++) {
+          for (size_t k = 0; k < n_in; k++) { legacy.push_back(weight[k * n_out + j]); }
+        }
+      }
+      legacy.insert(legacy.end(), bias, bias + n_out);
+    }
+    auto converted = nn::WeightFile::fromLegacy(reinterpret_cast<const char*>(legacy.data()), legacy.size() * sizeof(float));
+    REQUIRE(converted->size == file->size);
+    CHECK(std::memcmp(converted->data, file->data, file->size) == 0);
+  }
+
+  SECTION("fromFile") {
+    string filename = test_utils::makeTempPath("weight-file-test.bin");
+    {
+      std::ofstream ostr(filename, std::ios_base::out | std::ios_base::binary);
+      ostr.write(nn::kEmbeddedWeight, nn::kEmbeddedWeightSize);
+    }
+    nn::Evaluator evaluator1, evaluator2;
+    evaluator1.loadEmbeddedWeight();
+    evaluator2.load(filename);
+    CHECK(std::get<DefaultEvaluator>(evaluator2.impl).model->file->mapped != nullptr);
+    Position pos;
+    pos.initialize("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    evaluator1.initialize(pos);
+    evaluator2.initialize(pos);
+    CHECK(evaluator1.evaluate() == evaluator2.evaluate());
+
+    // Invalid files are rejected without changing evaluator
+    CHECK(nn::WeightFile::fromFile(filename + ".missing") == nullptr);
+    CHECK_FALSE(evaluator2.load(filename + ".missing"));
+    {
+      std::ofstream ostr(filename, std::ios_base::out | std::ios_base::binary);
+      ostr << "not a weight file";
+    }
+    CHECK(nn::WeightFile::fromFile(filename) == nullptr);
+    {
+      // Stale version
+      string data(nn::kEmbeddedWeight, nn::kEmbeddedWeightSize);
+      reinterpret_cast<nn::WeightFile::Header*>(data.data())->version++;
+      std::ofstream ostr(filename, std::ios_base::out | std::ios_base::binary);
+      ostr.write(data.data(), data.size());
+    }
+    CHECK(nn::WeightFile::fromFile(filename) == nullptr);
+    CHECK_FALSE(evaluator2.load(filename));
+    CHECK(evaluator1.evaluate() == evaluator2.evaluate());
+    std::remove(filename.c_str());
+  }
+}
+
+// Random weight of given shape
+TEST_CASE("nn::Evaluator::load") {
+  nn::Evaluator evaluator;
+  evaluator.loadEmbeddedWeight();
+  CHECK(evaluator.architecture() == "HalfKP-128x32x32");
+
+  vector<std::tuple<uint32_t, uint32_t, nn::WeightFile::FeatureSet, string>> cases = {
+    {nn::HalfKP::kWidth, 256, nn::WeightFile::kHalfKP, "HalfKP-256x32x32"},
+    {nn::HalfKP::kWidth,  64, nn::WeightFile::kHalfKP, "HalfKP-64x32x32"},
+    {nn::HalfKA::kWidth, 128, nn::WeightFile::kHalfKA, "HalfKA-128x32x32"},
+  };
+  for (auto [width1, width2, feature_set, name] : cases) {
+    REQUIRE(evaluator.load(test_utils::makeWeightFile({width1, width2, 32, 32, 1}, feature_set)));
+    CHECK(evaluator.architecture() == name);
+
+    // Incremental update is consistent with initialization
+    nn::Evaluator expected = evaluator;
+    Position pos("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    pos.evaluator = &evaluator;
+    pos.reset();
+    pos.makeMove(Move(kC4, kC5));
+    expected.initialize(pos);
+    CHECK(evaluator.evaluate() == expected.evaluate());
+  }
+
+  // Unsupported shape
+  CHECK_FALSE(evaluator.load(test_utils::makeWeightFile({nn::HalfKP::kWidth, 96, 32, 32, 1}, nn::WeightFile::kHalfKP)));
+  CHECK_FALSE(evaluator.load(test_utils::makeWeightFile({nn::HalfKP::kWidth, 128, 32, 32, 1}, nn::WeightFile::kHalfKA)));
+  CHECK(evaluator.architecture() == "HalfKA-128x32x32");
+}
+
+TEST_CASE("nn::HalfKA") {
+  using Arch = nn::Architecture<nn::HalfKA, 128, 32, 32>;
+  using Impl = nn::EvaluatorImpl<Arch>;
+  nn::Evaluator evaluator, expected;
+  evaluator.load(test_utils::makeWeightFile({Arch::WIDTH1, Arch::WIDTH2, Arch::WIDTH3, Arch::WIDTH4, 1}, nn::WeightFile::kHalfKA));
+  expected = evaluator;
+
+  SECTION("update") {
+    auto fen = "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1";
+    Position pos(fen);
+    pos.evaluator = &evaluator;
+    pos.reset();
+
+    auto check = [&]() {
+      expected.initialize(pos);
+      auto& x = std::get<Impl>(evaluator.impl);
+      auto& y = std::get<Impl>(expected.impl);
+      if (x.keys != y.keys) { return false; }
+      for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < Arch::WIDTH2; j++) {
+          if (std::abs(x.accumulator[i][j] - y.accumulator[i][j]) > 1e-4) { return false; }
+        }
+      }
+      return true;
+    };
+
+    // Including king moves within bucket (G1H1) and across buckets (E8G8)
+    vector<Move> moves = {
+      Move(kC4, kC5), Move(kD7, kD5), Move(kC5, kD6, kEnpassant), Move(kB2, kA1, kPromotion, kQueen),
+      Move(kG1, kH1), Move(kE8, kG8, kCastling), Move(kD1, kA1), Move(kG8, kH8)};
+    for (auto move : moves) {
+      pos.makeMove(move);
+      CHECK(check());
+    }
+    for (int i = moves.size() - 1; i >= 0; i--) {
+      pos.unmakeMove(moves[i]);
+      CHECK(check());
+    }
+  }
+
+  SECTION("mirror") {
+    // Horizontally mirrored positions have same features
+    Position pos1("4k3/1p6/2n5/8/3P4/8/5PPP/6K1 w - - 0 1");
+    Position pos2("3k4/6p1/5n2/8/4P3/8/PPP5/1K6 w - - 0 1");
+    evaluator.initialize(pos1);
+    expected.initialize(pos2);
+    CHECK(evaluator.evaluate() == expected.evaluate());
+  }
+
+  SECTION("width") {
+    int max_index = 0;
+    for (Square king = 0; king < 64; king++) {
+      for (Color perspective = 0; perspective < 2; perspective++) {
+        int key = nn::HalfKA::getKey(perspective, king);
+        for (Square sq = 0; sq < 64; sq++) {
+          max_index = std::max(max_index, nn::HalfKA::getIndex(perspective, key, !perspective, kKing, sq));
+        }
+      }
+    }
+    CHECK(max_index == nn::HalfKA::kWidth - 1);
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../base.hpp"
+#include "weight_file.hpp"
+
+namespace nn {
+
+//
+// Input feature sets (index of l1 row for each piece from each perspective)
+//
+// - "key" is a per-perspective state derived from king square. Changing it invalidates all features (i.e. requires refresh).
+// - "getIndex" returns -1 if the piece is not a feature from the perspective.
+// - Black perspective sees the board with ranks flipped.
+//
+
+// (piece-type, piece-position, king-position) without king pieces (cf. makeIndices in training/preprocess.cpp)
+struct HalfKP {
+  static inline constexpr auto kType = WeightFile::kHalfKP;
+  static inline constexpr int kWidth = 10 * 64 * 64;
+  static inline constexpr const char* kName = "HalfKP";
+
+  static int getKey(Color perspective, Square king) {
+    return perspective == kWhite ? king : SQ::flipRank(king);
+  }
+
+  static int getIndex(Color perspective, int key, Color color, PieceType type, Square sq) {
+    if (type == kKing) { return -1; }
+    int plane = type + 5 * (color != perspective);
+    int sq_p = perspective == kWhite ? sq : SQ::flipRank(sq);
+    return (plane * 64 + sq_p) * 64 + key;
+  }
+};
+
+// (king-bucket, piece-type, piece-position) mirrored horizontally so that own king is on files A-D.
+// Own king is represented only by bucket while opponent king is a feature (HalfKAv2-like but 7x smaller than HalfKP).
+struct HalfKA {
+  static inline constexpr auto kType = WeightFile::kHalfKA;
+  static inline constexpr int kNumBuckets = 8;
+  static inline constexpr int kNumPlanes = 11;
+  static inline constexpr int kWidth = kNumBuckets * kNumPlanes * 64;
+  static inline constexpr const char* kName = "HalfKA";
+
+  // Symmetric w.r.t. mirroring
+  static inline constexpr array<int, 64> kKingBuckets = {
+    0, 0, 1, 1, 1, 1, 0, 0,
+    2, 2, 3, 3, 3, 3, 2, 2,
+    4, 4, 5, 5, 5, 5, 4, 4,
+    4, 4, 5, 5, 5, 5, 4, 4,
+    6, 6, 7, 7, 7, 7, 6, 6,
+    6, 6, 7, 7, 7, 7, 6, 6,
+    6, 6, 7, 7, 7, 7, 6, 6,
+    6, 6, 7, 7, 7, 7, 6, 6,
+  };
+
+  // Pack bucket and mirroring
+  static int getKey(Color perspective, Square king) {
+    Square king_p = perspective == kWhite ? king : SQ::flipRank(king);
+    bool mirror = SQ::toFile(king_p) >= kFileE;
+    return kKingBuckets[king_p] * 2 + mirror;
+  }
+
+  static int getIndex(Color perspective, int key, Color color, PieceType type, Square sq) {
+    if (type == kKing && color == perspective) { return -1; }
+    int plane = (type == kKing) ? 10 : (type + 5 * (color != perspective));
+    int sq_p = perspective == kWhite ? sq : SQ::flipRank(sq);
+    if (key & 1) { sq_p = SQ::flipFile(sq_p); }
+    return ((key / 2) * kNumPlanes + plane) * 64 + sq_p;
+  }
+};
+
+}; // namespace nn
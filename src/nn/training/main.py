@@ -5,18 +5,37 @@ import numpy as np
 from tqdm import tqdm
 from datetime import datetime
 import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import weight_file as weight_file_format
 
 #
 # Model
 #
 
-WIDTH1 = 10 * 64 * 64 # input = { (piece-type, piece-position, king-position) }
+# Input feature sets (cf. nn_preprocess --feature-set and feature_set.hpp)
+FEATURE_SETS = {
+  "halfkp": (weight_file_format.FEATURE_SET_HALFKP, 10 * 64 * 64), # { (piece-type, piece-position, king-position) }
+  "halfka": (weight_file_format.FEATURE_SET_HALFKA, 8 * 11 * 64),  # { (king-bucket, piece-type, piece-position) } mirrored
+}
+
+FEATURE_SET = "halfkp"
+WIDTH1 = FEATURE_SETS[FEATURE_SET][1]
 WIDTH2 = 128
 WIDTH3 = 32
 WIDTH4 = 32
 EMBEDDING_WIDTH = WIDTH1 + 1
 EMBEDDING_PAD = WIDTH1
 
+
+def set_feature_set(name):
+  global FEATURE_SET, WIDTH1, EMBEDDING_WIDTH, EMBEDDING_PAD
+  FEATURE_SET = name
+  WIDTH1 = FEATURE_SETS[name][1]
+  EMBEDDING_WIDTH = WIDTH1 + 1
+  EMBEDDING_PAD = WIDTH1
+
 DTYPE = torch.float32
 
 class MyModel(nn.Module):
@@ -290,9 +309,7 @@ def process_model_parameters(infile, outfile):
   parameters = torch.load(infile, map_location=DEVICE)["model_state_dict"]
   parameters = rename_model_parameters(parameters)
   print(f":: Writing weight ({outfile})")
-  with open(outfile, 'wb') as f:
-    for tensor in parameters.values():
-      f.write(bytes(np.array(tensor)))
+  data = b"".join(bytes(np.array(tensor)) for tensor in parameters.values())
 
   # Veryfy size
   expected = 0
@@ -301,7 +318,11 @@ def process_model_parameters(infile, outfile):
   expected += (WIDTH3 + 1) * WIDTH4
   expected += (WIDTH4 + 1)
   expected *= 4
-  assert os.stat(outfile).st_size == expected
+  assert len(data) == expected
+
+  # Convert to aligned format for c++ runtime (cf. weight_file.py)
+  with open(outfile, 'wb') as f:
+    f.write(weight_file_format.convert_legacy(data, [WIDTH1, WIDTH2, WIDTH3, WIDTH4, 1], FEATURE_SETS[FEATURE_SET][0]))
 
 
 # Export data for embedding projection visualization
@@ -343,7 +364,9 @@ COMMANDS = [
   "export_embedding"
 ]
 
-def main(command, dataset, test_dataset, checkpoint, checkpoint_dir, weight_file, **kwargs):
+def main(command, dataset, test_dataset, checkpoint, checkpoint_dir, weight_file, feature_set, **kwargs):
+  set_feature_set(feature_set)
+
   if command == "process_model_parameters":
     assert checkpoint and weight_file
     process_model_parameters(infile=checkpoint, outfile=weight_file)
@@ -383,6 +406,7 @@ def main_cli():
   parser.add_argument("--learning-rate", type=float, default=0.001)
   parser.add_argument("--scheduler-patience", type=float, default=0)
   parser.add_argument("--loss-mode", type=str, default="bce")
+  parser.add_argument("--feature-set", type=str, choices=list(FEATURE_SETS.keys()), default="halfkp")
   # export_embedding
   parser.add_argument("--data-tsv", type=str)
   parser.add_argument("--meta-tsv", type=str)
@@ -1,8 +1,9 @@
 //
-// .binpack -> .halfkp
+// .binpack -> .halfkp (or .halfka)
 //
 
 #include "../../misc.hpp"
+#include "../feature_set.hpp"
 
 
 // Use Tomasz Sobczyk's binpack routines
@@ -12,32 +13,28 @@
 #pragma clang diagnostic pop
 
 
+// Same indices as nn::EvaluatorImpl::getIndices
+template<typename F>
 void makeIndices(const chess::Position& pos, uint16_t* x_w, uint16_t* x_b) {
-  using namespace chess;
+  int key_w = F::getKey(kWhite, int(pos.kingSquare(chess::Color::White)));
+  int key_b = F::getKey(kBlack, int(pos.kingSquare(chess::Color::Black)));
 
-  auto flip = [](int sq) -> int { return sq ^ (7 << 3); };
-
-  int k_w = int(pos.kingSquare(Color::White));
-  int k_b = int(pos.kingSquare(Color::Black));
-
-  int cnt = 0;
+  int cnt_w = 0, cnt_b = 0;
   for (int sq = 0; sq < 64; sq++) {
-    Piece piece = pos.pieceAt(Square(sq));
-    Color color = piece.color();
-    PieceType type = piece.type();
-    if (type == PieceType::None) { continue; }
-    if (type == PieceType::King) { continue; }
-    cnt++;
-    ASSERT(cnt <= 32);
-
-    int t = int(type);
-    int t_w = t + 5 * (color == Color::Black);
-    int t_b = t + 5 * (color == Color::White);
-    *(x_w++) = (t_w * 64 +      sq ) * 64 +      k_w ;
-    *(x_b++) = (t_b * 64 + flip(sq)) * 64 + flip(k_b);
+    chess::Piece piece = pos.pieceAt(chess::Square(sq));
+    if (piece.type() == chess::PieceType::None) { continue; }
+    Color color = int(piece.color());
+    PieceType type = int(piece.type());
+    int index_w = F::getIndex(kWhite, key_w, color, type, sq);
+    int index_b = F::getIndex(kBlack, key_b, color, type, sq);
+
+    // NOTE: Keep last slot of x_b for score
+    if (index_w >= 0) { *(x_w++) = index_w; ASSERT(++cnt_w <= 31); }
+    if (index_b >= 0) { *(x_b++) = index_b; ASSERT(++cnt_b <= 31); }
   }
 }
 
+template<typename F>
 void preprocess(const string& infile, const string& outfile, bool shuffle, int buffer_size, int eval_limit) {
 
   binpack::CompressedTrainingDataEntryReader binpack_reader(infile);
@@ -47,7 +44,7 @@ void preprocess(const string& infile, const string& outfile, bool shuffle, int b
 
   // Each entry is 128bytes (4 times worse than packed sfen format)
   using Entry = array<uint16_t, 64>;
-  const uint16_t kEmbeddingPad = 10 * 64 * 64;
+  const uint16_t kEmbeddingPad = F::kWidth;
 
   vector<Entry> entries;
   entries.reserve(buffer_size);
@@ -70,7 +67,7 @@ void preprocess(const string& infile, const string& outfile, bool shuffle, int b
     // NOTE: gensfen's score is "side-to-move" perspective, but we want evaluation to be "white" perspective.
     if (e.pos.sideToMove() == chess::Color::Black) { std::swap(x_w, x_b); }
 
-    makeIndices(e.pos, x_w, x_b);
+    makeIndices<F>(e.pos, x_w, x_b);
 
     // Sneak score into the last unused index
     entry[63] = e.score;
@@ -96,6 +93,7 @@ int main(int argc, const char* argv[]) {
   bool shuffle = cli.getArg<int>("--shuffle").value_or(1);
   int buffer_size = cli.getArg<int>("--buffer-size").value_or(500000);
   int eval_limit = cli.getArg<int>("--eval-limit").value_or(10000); // NOTE: gensfen's "eval_limit" doesn't perfectly limit, so here we can filter further.
+  auto feature_set = cli.getArg<string>("--feature-set").value_or("halfkp");
   if (!infile) {
     std::cerr << cli.help() << std::endl;
     return 1;
@@ -104,9 +102,14 @@ int main(int argc, const char* argv[]) {
     std::cerr << ":: Invalid infile" << std::endl;
     return 1;
   }
+  if (feature_set != "halfkp" && feature_set != "halfka") {
+    std::cerr << ":: Invalid feature-set" << std::endl;
+    return 1;
+  }
   if (!outfile) {
-    outfile = infile->substr(0, infile->size() - string("binpack").size()) + "halfkp";
+    outfile = infile->substr(0, infile->size() - string("binpack").size()) + feature_set;
   }
-  preprocess(*infile, *outfile, shuffle, buffer_size, eval_limit);
+  if (feature_set == "halfkp") { preprocess<nn::HalfKP>(*infile, *outfile, shuffle, buffer_size, eval_limit); }
+  if (feature_set == "halfka") { preprocess<nn::HalfKA>(*infile, *outfile, shuffle, buffer_size, eval_limit); }
   return 0;
 }
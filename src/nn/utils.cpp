@@ -213,6 +213,51 @@ void sub(const float x[N], const float y[N], float z[N]) {
   }
 }
 
+template<int N>
+void accumulate(const float x[N], const float* const added[], int num_added, const float* const removed[], int num_removed, float y[N]) {
+  static_assert(N % kMaxSimdWidth == 0);
+
+  if constexpr (kUseAVX) {
+    // Keep a block of accumulator on eight registers while applying all rows
+    constexpr int B = std::min(N, 8 * 8);
+    static_assert(N % B == 0);
+    for (int i = 0; i < N; i += B) {
+      __m256 v[B / 8];
+      for (int j = 0; j < B / 8; j++) { v[j] = _mm256_load_ps(&x[i + j * 8]); }
+      for (int k = 0; k < num_added; k++) {
+        for (int j = 0; j < B / 8; j++) { v[j] = _mm256_add_ps(v[j], _mm256_load_ps(&added[k][i + j * 8])); }
+      }
+      for (int k = 0; k < num_removed; k++) {
+        for (int j = 0; j < B / 8; j++) { v[j] = _mm256_sub_ps(v[j], _mm256_load_ps(&removed[k][i + j * 8])); }
+      }
+      for (int j = 0; j < B / 8; j++) { _mm256_store_ps(&y[i + j * 8], v[j]); }
+    }
+
+  } else if constexpr (kUseSSE) {
+    constexpr int B = std::min(N, 8 * 4);
+    static_assert(N % B == 0);
+    for (int i = 0; i < N; i += B) {
+      __m128 v[B / 4];
+      for (int j = 0; j < B / 4; j++) { v[j] = _mm_load_ps(&x[i + j * 4]); }
+      for (int k = 0; k < num_added; k++) {
+        for (int j = 0; j < B / 4; j++) { v[j] = _mm_add_ps(v[j], _mm_load_ps(&added[k][i + j * 4])); }
+      }
+      for (int k = 0; k < num_removed; k++) {
+        for (int j = 0; j < B / 4; j++) { v[j] = _mm_sub_ps(v[j], _mm_load_ps(&removed[k][i + j * 4])); }
+      }
+      for (int j = 0; j < B / 4; j++) { _mm_store_ps(&y[i + j * 4], v[j]); }
+    }
+
+  } else {
+    for (int i = 0; i < N; i++) {
+      float v = x[i];
+      for (int k = 0; k < num_added; k++) { v += added[k][i]; }
+      for (int k = 0; k < num_removed; k++) { v -= removed[k][i]; }
+      y[i] = v;
+    }
+  }
+}
+
 template<int N1, int N2>
 void affine(const float A[N2][N1], const float x[N1], const float b[N2], float y[N2]) {
   if constexpr (N2 % 4 == 0) {
@@ -227,16 +272,131 @@ void affine(const float A[N2][N1], const float x[N1], const float b[N2], float y
   }
 }
 
+template<int N1, int N2>
+void reluAffine(const float At[N1][N2], const float x[N1], const float b[N2], float y[N2]) {
+  static_assert(N1 % kMaxSimdWidth == 0 && N2 % kMaxSimdWidth == 0);
+
+  // Collect non-zero inputs after relu
+  alignas(kMaxFloatVectorSize) int indices[N1];
+  int num_indices = 0;
+
+  if constexpr (kUseAVX) {
+    const __m256 kZero = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < N1; i += 8) {
+      uint32_t mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(&x[i]), kZero, _CMP_GT_OQ));
+      for (; mask; mask &= mask - 1) { indices[num_indices++] = i + __builtin_ctz(mask); }
+    }
+
+    // Broadcast each input and accumulate its (contiguous) row of "At" on registers
+    __m256 z[N2 / 8];
+    for (int j = 0; j < N2 / 8; j++) { z[j] = _mm256_load_ps(&b[j * 8]); }
+    for (int k = 0; k < num_indices; k++) {
+      int i = indices[k];
+      auto xv = _mm256_broadcast_ss(&x[i]);
+      for (int j = 0; j < N2 / 8; j++) {
+        if constexpr (kUseFMA) {
+          z[j] = _mm256_fmadd_ps(xv, _mm256_load_ps(&At[i][j * 8]), z[j]);
+        } else {
+          z[j] = _mm256_add_ps(_mm256_mul_ps(xv, _mm256_load_ps(&At[i][j * 8])), z[j]);
+        }
+      }
+    }
+    for (int j = 0; j < N2 / 8; j++) { _mm256_store_ps(&y[j * 8], z[j]); }
+
+  } else if constexpr (kUseSSE) {
+    const __m128 kZero = {0, 0, 0, 0};
+    for (int i = 0; i < N1; i += 4) {
+      uint32_t mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_load_ps(&x[i]), kZero));
+      for (; mask; mask &= mask - 1) { indices[num_indices++] = i + __builtin_ctz(mask); }
+    }
+
+    __m128 z[N2 / 4];
+    for (int j = 0; j < N2 / 4; j++) { z[j] = _mm_load_ps(&b[j * 4]); }
+    for (int k = 0; k < num_indices; k++) {
+      int i = indices[k];
+      auto xv = _mm_load1_ps(&x[i]);
+      for (int j = 0; j < N2 / 4; j++) {
+        z[j] = _mm_add_ps(_mm_mul_ps(xv, _mm_load_ps(&At[i][j * 4])), z[j]);
+      }
+    }
+    for (int j = 0; j < N2 / 4; j++) { _mm_store_ps(&y[j * 4], z[j]); }
+
+  } else {
+    for (int i = 0; i < N1; i++) {
+      if (x[i] > 0) { indices[num_indices++] = i; }
+    }
+    for (int j = 0; j < N2; j++) { y[j] = b[j]; }
+    for (int k = 0; k < num_indices; k++) {
+      int i = indices[k];
+      for (int j = 0; j < N2; j++) { y[j] += x[i] * At[i][j]; }
+    }
+  }
+}
+
+template<int N1, int N2>
+void reluAffineBatch(const float At[N1][N2], const float x[][N1], int n, const float b[N2], float y[][N2]) {
+  static_assert(N1 % kMaxSimdWidth == 0 && N2 % kMaxSimdWidth == 0);
+
+  if constexpr (kUseAVX && N2 <= 32) {
+    // Two inputs at once so that each loaded weight is used twice
+    // (2 x 4 registers for outputs, 4 registers for weights and 2 registers for inputs)
+    const __m256 kZero = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (int r = 0; r < n; r += 2) {
+      const float* x0 = x[r];
+      const float* x1 = x[std::min(r + 1, n - 1)];
+      __m256 z0[N2 / 8], z1[N2 / 8];
+      for (int j = 0; j < N2 / 8; j++) { z0[j] = z1[j] = _mm256_load_ps(&b[j * 8]); }
+      for (int i = 0; i < N1; i++) {
+        auto xv0 = _mm256_max_ps(_mm256_broadcast_ss(&x0[i]), kZero);
+        auto xv1 = _mm256_max_ps(_mm256_broadcast_ss(&x1[i]), kZero);
+        for (int j = 0; j < N2 / 8; j++) {
+          auto w = _mm256_load_ps(&At[i][j * 8]);
+          if constexpr (kUseFMA) {
+            z0[j] = _mm256_fmadd_ps(xv0, w, z0[j]);
+            z1[j] = _mm256_fmadd_ps(xv1, w, z1[j]);
+          } else {
+            z0[j] = _mm256_add_ps(_mm256_mul_ps(xv0, w), z0[j]);
+            z1[j] = _mm256_add_ps(_mm256_mul_ps(xv1, w), z1[j]);
+          }
+        }
+      }
+      for (int j = 0; j < N2 / 8; j++) { _mm256_store_ps(&y[r][j * 8], z0[j]); }
+      if (r + 1 < n) {
+        for (int j = 0; j < N2 / 8; j++) { _mm256_store_ps(&y[r + 1][j * 8], z1[j]); }
+      }
+    }
+
+  } else {
+    for (int r = 0; r < n; r++) {
+      reluAffine<N1, N2>(At, x[r], b, y[r]);
+    }
+  }
+}
+
 // Explicit instantiation
 template void relu<256>(const float x[256], float y[256]);
 template void relu<32>(const float x[32], float y[32]);
 
-template void copy<128>(const float x[128], float y[128]);
-template void add<128>(const float x[128], const float y[128], float z[128]);
-template void sub<128>(const float x[128], const float y[128], float z[128]);
+// Accumulator widths (cf. Architecture in evaluator.hpp)
+#define INSTANTIATE_ACCUMULATOR(N) \
+  template void copy<N>(const float x[N], float y[N]); \
+  template void add<N>(const float x[N], const float y[N], float z[N]); \
+  template void sub<N>(const float x[N], const float y[N], float z[N]); \
+  template void accumulate<N>(const float x[N], const float* const added[], int num_added, const float* const removed[], int num_removed, float y[N]); \
+  template void affine<2 * N, 32>(const float A[32][2 * N], const float x[2 * N], const float b[32], float y[32]); \
+  template void reluAffine<2 * N, 32>(const float At[2 * N][32], const float x[2 * N], const float b[32], float y[32]); \
+  template void reluAffineBatch<2 * N, 32>(const float At[2 * N][32], const float x[][2 * N], int n, const float b[32], float y[][32]);
+
+INSTANTIATE_ACCUMULATOR(32)
+INSTANTIATE_ACCUMULATOR(64)
+INSTANTIATE_ACCUMULATOR(128)
+INSTANTIATE_ACCUMULATOR(256)
+#undef INSTANTIATE_ACCUMULATOR
 
-template void affine<256, 32>(const float A[32][256], const float x[256], const float b[32], float y[32]);
 template void affine< 32, 32>(const float A[32][ 32], const float x[ 32], const float b[32], float y[32]);
+template void reluAffine< 32, 32>(const float At[ 32][32], const float x[ 32], const float b[32], float y[32]);
+template void reluAffineBatch< 32, 32>(const float At[ 32][32], const float x[][ 32], int n, const float b[32], float y[][32]);
+
 template void affine< 32,  1>(const float A[ 1][ 32], const float x[ 32], const float b[ 1], float y[ 1]);
 
 }; // namespace nn
@@ -19,41 +19,76 @@ void add(const float x[N], const float y[N], float z[N]);
 template<int N>
 void sub(const float x[N], const float y[N], float z[N]);
 
+// y = x + (sum of "added" rows) - (sum of "removed" rows) in a single pass over registers
+template<int N>
+void accumulate(const float x[N], const float* const added[], int num_added, const float* const removed[], int num_removed, float y[N]);
+
+// Prefetch all cache lines of a row (e.g. to hide the latency of l1 rows while making a move)
+template<int N>
+inline void prefetch(const float x[N]) {
+  for (int i = 0; i < N; i += 64 / sizeof(float)) { __builtin_prefetch(&x[i]); }
+}
+
 template<int N1, int N2>
 void affine(const float A[N2][N1], const float x[N1], const float b[N2], float y[N2]);
 
+// y = A relu(x) + b given transposed A (i.e. At[N1][N2]) while skipping zero inputs after relu
+template<int N1, int N2>
+void reluAffine(const float At[N1][N2], const float x[N1], const float b[N2], float y[N2]);
+
+// Batched "reluAffine" for "n" inputs (i.e. small GEMM)
+template<int N1, int N2>
+void reluAffineBatch(const float At[N1][N2], const float x[][N1], int n, const float b[N2], float y[][N2]);
+
+//
+// Layers are views of weights (e.g. on mmap-ed WeightFile)
+//
+
 template<int N1, int N2>
 struct Linear {
   static_assert(N1 % kMaxSimdWidth == 0);
 
-  alignas(kMaxFloatVectorSize) float weight[N2][N1] = {};
-  alignas(kMaxFloatVectorSize) float bias[N2] = {};
+  const float (*weight)[N1] = nullptr; // [N2][N1]
+  const float* bias = nullptr;
 
-  void load(std::istream& istr) {
-    istr.read(reinterpret_cast<char*>(weight[0]), N1 * N2 * sizeof(float));
-    ASSERT(istr.gcount() == N1 * N2 * sizeof(float));
-    istr.read(reinterpret_cast<char*>(bias), N2 * sizeof(float));
-    ASSERT(istr.gcount() == N2 * sizeof(float));
+  void load(const float* w, const float* b) {
+    weight = reinterpret_cast<const float(*)[N1]>(w);
+    bias = b;
   }
 
-  void forward(float x[N1], float y[N2]) {
+  void forward(const float x[N1], float y[N2]) const {
     affine<N1, N2>(weight, x, bias, y);
   }
 };
 
+// Linear layer with relu fused on input (weight is stored as transposed for broadcasting each non-zero input)
+template<int N1, int N2>
+struct SparseLinear {
+  static_assert(N1 % kMaxSimdWidth == 0 && N2 % kMaxSimdWidth == 0);
+
+  const float (*weight)[N2] = nullptr; // [N1][N2] i.e. contiguous in output dimention
+  const float* bias = nullptr;
+
+  void load(const float* w, const float* b) {
+    weight = reinterpret_cast<const float(*)[N2]>(w);
+    bias = b;
+  }
+
+  void forward(const float x[N1], float y[N2]) const {
+    reluAffine<N1, N2>(weight, x, bias, y);
+  }
+};
+
 template<int N1, int N2>
 struct InputLayer {
   static_assert(N2 % kMaxSimdWidth == 0);
 
-  alignas(kMaxFloatVectorSize) float weight[N1][N2] = {}; // Contiguous in output dimention
-  alignas(kMaxFloatVectorSize) float bias[N2] = {};
+  const float (*weight)[N2] = nullptr; // [N1][N2] i.e. contiguous in output dimention
+  const float* bias = nullptr;
 
-  void load(std::istream& istr) {
-    // NOTE: pytorch's embedding weight is already transposed
-    istr.read(reinterpret_cast<char*>(weight[0]), N1 * N2 * sizeof(float));
-    ASSERT(istr.gcount() == N1 * N2 * sizeof(float));
-    istr.read(reinterpret_cast<char*>(bias), N2 * sizeof(float));
-    ASSERT(istr.gcount() == N2 * sizeof(float));
+  void load(const float* w, const float* b) {
+    weight = reinterpret_cast<const float(*)[N2]>(w);
+    bias = b;
   }
 };
 
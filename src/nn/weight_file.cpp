@@ -0,0 +1,136 @@
+#include "weight_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nn {
+
+namespace {
+  size_t align(size_t offset) { return (offset + WeightFile::kAlignment - 1) / WeightFile::kAlignment * WeightFile::kAlignment; }
+
+  // Offsets of (weight, bias) of i-th layer
+  pair<size_t, size_t> getLayerOffsets(const WeightFile::Header& header, int layer) {
+    size_t offset = sizeof(WeightFile::Header);
+    for (int i = 0; ; i++) {
+      auto [n_in, n_out] = WeightFile::getLayerShape(header, i);
+      size_t offset_weight = align(offset);
+      size_t offset_bias = align(offset_weight + n_in * n_out * sizeof(float));
+      if (i == layer) { return {offset_weight, offset_bias}; }
+      offset = offset_bias + n_out * sizeof(float);
+    }
+  }
+}
+
+WeightFile::~WeightFile() {
+  if (mapped) { munmap(mapped, size); }
+}
+
+std::shared_ptr<const WeightFile> WeightFile::fromFile(const string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) { return nullptr; }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) { close(fd); return nullptr; }
+  size_t file_size = st.st_size;
+  void* ptr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) { return nullptr; }
+
+  auto file = std::make_shared<WeightFile>();
+  file->mapped = ptr;
+  file->data = reinterpret_cast<const char*>(ptr);
+  file->size = file_size;
+  if (isLegacy(file->data, file->size)) {
+    return fromLegacy(file->data, file->size);
+  }
+  if (!file->validate()) { return nullptr; }
+  return file;
+}
+
+std::shared_ptr<const WeightFile> WeightFile::fromMemory(const char* data, size_t size) {
+  if (isLegacy(data, size)) {
+    return fromLegacy(data, size);
+  }
+  auto file = std::make_shared<WeightFile>();
+  file->data = data;
+  file->size = size;
+  if (!file->validate()) { return nullptr; }
+  return file;
+}
+
+std::shared_ptr<const WeightFile> WeightFile::fromLegacy(const char* data, size_t size, const array<uint32_t, 5>& dims, FeatureSet feature_set) {
+  // Legacy format is concatenation of pytorch weights (i.e. Linear weight is [out][in])
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.feature_set = feature_set;
+  header.quantization = kFloat32;
+  header.num_layers = dims.size() - 1;
+  std::copy(dims.begin(), dims.end(), header.dims.begin());
+  auto [_offset_weight, last_offset_bias] = getLayerOffsets(header, header.num_layers - 1);
+  header.size = align(last_offset_bias + dims.back() * sizeof(float));
+
+  // Legacy format has no header to check other than total size
+  size_t expected_size = 0;
+  for (int i = 0; i < (int)header.num_layers; i++) {
+    auto [n_in, n_out] = getLayerShape(header, i);
+    expected_size += (n_in + 1) * n_out * sizeof(float);
+  }
+  if (size != expected_size) { return nullptr; }
+
+  auto file = std::make_shared<WeightFile>();
+  file->owned.reset(static_cast<char*>(std::aligned_alloc(kAlignment, header.size)));
+  ASSERT(file->owned);
+  std::memset(file->owned.get(), 0, header.size);
+  std::memcpy(file->owned.get(), &header, sizeof(Header));
+  file->data = file->owned.get();
+  file->size = header.size;
+
+  size_t offset = 0;
+  for (int i = 0; i < (int)header.num_layers; i++) {
+    auto [n_in, n_out] = getLayerShape(header, i);
+    auto [offset_weight, offset_bias] = getLayerOffsets(header, i);
+    auto weight = reinterpret_cast<float*>(file->owned.get() + offset_weight);
+    auto bias = reinterpret_cast<float*>(file->owned.get() + offset_bias);
+    ASSERT(offset + (n_in + 1) * n_out * sizeof(float) <= size);
+    auto src = reinterpret_cast<const float*>(data + offset);
+    if (i == 0) {
+      // NOTE: pytorch's embedding weight is already transposed
+      std::copy_n(src, n_in * n_out, weight);
+    } else {
+      for (size_t j = 0; j < n_out; j++) {
+        for (size_t k = 0; k < n_in; k++) {
+          weight[k * n_out + j] = src[j * n_in + k];
+        }
+      }
+    }
+    std::copy_n(src + n_in * n_out, n_out, bias);
+    offset += (n_in + 1) * n_out * sizeof(float);
+  }
+  ASSERT(offset == size);
+  return file;
+}
+
+pair<size_t, size_t> WeightFile::getLayerShape(const Header& header, int i) {
+  return {header.dims[i] * (i == 1 ? 2 : 1), header.dims[i + 1]};
+}
+
+pair<const float*, const float*> WeightFile::getLayer(int i) const {
+  ASSERT(0 <= i && i < (int)header().num_layers);
+  auto [offset_weight, offset_bias] = getLayerOffsets(header(), i);
+  return {reinterpret_cast<const float*>(data + offset_weight), reinterpret_cast<const float*>(data + offset_bias)};
+}
+
+bool WeightFile::validate() const {
+  if (reinterpret_cast<uintptr_t>(data) % kAlignment != 0) { return false; }
+  if (size < sizeof(Header)) { return false; }
+  if (header().version != kVersion) { return false; }
+  if (header().quantization != kFloat32) { return false; }
+  if (!(1 <= header().num_layers && header().num_layers <= kMaxLayers)) { return false; }
+  if (header().size != size) { return false; }
+  int last = header().num_layers - 1;
+  auto [_offset_weight, offset_bias] = getLayerOffsets(header(), last);
+  return offset_bias + getLayerShape(header(), last).second * sizeof(float) <= size;
+}
+
+}; // namespace nn
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../misc.hpp"
+
+namespace nn {
+
+//
+// Versioned weight file which can be used in place (cf. weight_file.py for the format)
+//
+
+struct WeightFile {
+  static inline constexpr char kMagic[8] = {'T', 'O', 'Y', 'C', 'H', 'E', 'S', 'S'};
+  static inline constexpr uint32_t kVersion = 1;
+  static inline constexpr size_t kAlignment = 64;
+  static inline constexpr int kMaxLayers = 7;
+  static inline constexpr array<uint32_t, 5> kLegacyDims = {10 * 64 * 64, 128, 32, 32, 1};
+
+  enum FeatureSet : uint32_t { kHalfKP, kHalfKA }; // cf. feature_set.hpp
+  enum Quantization : uint32_t { kFloat32 };
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t feature_set;
+    uint32_t quantization;
+    uint32_t num_layers;
+    array<uint32_t, kMaxLayers + 1> dims; // WIDTH1, WIDTH2, ... (2nd layer's input is 2 * WIDTH2 for both perspectives)
+    uint64_t size;
+  };
+  static_assert(sizeof(Header) == kAlignment);
+
+  const char* data = nullptr;
+  size_t size = 0;
+
+  // Backing memory is either read-only mmap of file, owned buffer (for legacy format) or static data (embedded weight)
+  void* mapped = nullptr;
+  std::unique_ptr<char, decltype(&std::free)> owned = {nullptr, &std::free};
+
+  WeightFile() {}
+  WeightFile(const WeightFile&) = delete;
+  ~WeightFile();
+
+  // nullptr if file can't be read or its header/size is invalid
+  static std::shared_ptr<const WeightFile> fromFile(const string& filename);
+  static std::shared_ptr<const WeightFile> fromMemory(const char* data, size_t size); // Without copy if not legacy format
+  static std::shared_ptr<const WeightFile> fromLegacy(const char* data, size_t size, const array<uint32_t, 5>& dims = kLegacyDims, FeatureSet feature_set = kHalfKP);
+
+  static bool isLegacy(const char* data, size_t size) { return size < sizeof(Header) || std::memcmp(data, kMagic, sizeof(kMagic)) != 0; }
+  static pair<size_t, size_t> getLayerShape(const Header&, int); // (in, out) of i-th layer
+
+  const Header& header() const { return *reinterpret_cast<const Header*>(data); }
+
+  // Weight ([in][out]) and bias of i-th layer
+  pair<const float*, const float*> getLayer(int) const;
+
+  bool validate() const;
+};
+
+}; // namespace nn
@@ -0,0 +1,110 @@
+#
+# Weight file format (cf. nn::WeightFile in weight_file.hpp)
+#
+# - 64 bytes header
+#     char     magic[8]      "TOYCHESS"
+#     uint32_t version       1
+#     uint32_t feature_set   0 (HalfKP), 1 (HalfKA)
+#     uint32_t quantization  0 (float32)
+#     uint32_t num_layers    4
+#     uint32_t dims[8]       widths (i.e. WIDTH1, WIDTH2, ... where 2nd layer's input is 2 * WIDTH2 for both perspectives)
+#     uint64_t size          total file size
+#
+# - Sections of (weight, bias) for each layer
+#     - each section starts at 64 bytes aligned offset
+#     - weight is stored as [in][out] (i.e. transposed pytorch Linear weight) so that runtime can use it in place
+#
+# - Legacy format is plain concatenation of pytorch weights (cf. process_model_parameters in training/main.py)
+#
+
+import struct, array
+
+MAGIC = b"TOYCHESS"
+VERSION = 1
+FEATURE_SET_HALFKP = 0
+FEATURE_SET_HALFKA = 1
+QUANTIZATION_FLOAT32 = 0
+HEADER_SIZE = 64
+ALIGNMENT = 64
+MAX_LAYERS = 7
+
+# Constants from training/main.py
+LEGACY_DIMS = [10 * 64 * 64, 128, 32, 32, 1]
+
+
+def align(offset):
+  return (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+def write(layers, dims, feature_set=FEATURE_SET_HALFKP):
+  # layers = [(weight, bias), ...] as array('f') where weight is [in][out]
+  num_layers = len(layers)
+  assert num_layers == len(dims) - 1 and num_layers <= MAX_LAYERS
+  body = b""
+  offset = HEADER_SIZE
+  for weight, bias in layers:
+    for section in [weight, bias]:
+      padding = align(offset) - offset
+      body += b"\0" * padding + section.tobytes()
+      offset += padding + len(section) * 4
+  size = align(offset)
+  body += b"\0" * (size - offset)
+  header = struct.pack("<8s4I8IQ", MAGIC, VERSION, feature_set, QUANTIZATION_FLOAT32, num_layers,
+                       *(list(dims) + [0] * (MAX_LAYERS + 1 - len(dims))), size)
+  assert len(header) == HEADER_SIZE
+  return header + body
+
+
+def read_header(data):
+  magic, version, feature_set, quantization, num_layers, *rest = struct.unpack_from("<8s4I8IQ", data)
+  dims, size = rest[:num_layers + 1], rest[-1]
+  return dict(magic=magic, version=version, feature_set=feature_set, quantization=quantization, dims=dims, size=size)
+
+
+def is_legacy(data):
+  return data[:len(MAGIC)] != MAGIC
+
+
+def transpose(x, n_out, n_in):
+  # [out][in] -> [in][out]
+  return array.array('f', (x[i * n_in + j] for j in range(n_in) for i in range(n_out)))
+
+
+def layer_shape(dims, i):
+  # (in, out) of i-th layer
+  return (dims[i] * (2 if i == 1 else 1), dims[i + 1])
+
+
+def convert_legacy(data, dims=LEGACY_DIMS, feature_set=FEATURE_SET_HALFKP):
+  x = array.array('f')
+  x.frombytes(data)
+  layers = []
+  offset = 0
+  for i in range(len(dims) - 1):
+    n_in, n_out = layer_shape(dims, i)
+    weight = x[offset:offset + n_in * n_out]
+    offset += n_in * n_out
+    bias = x[offset:offset + n_out]
+    offset += n_out
+    if i > 0:
+      weight = transpose(weight, n_out, n_in)
+    layers.append((weight, bias))
+  assert offset == len(x)
+  return write(layers, dims, feature_set)
+
+
+def main(command, infile, outfile=None):
+  with open(infile, 'rb') as f:
+    data = f.read()
+  if command == "info":
+    print("legacy" if is_legacy(data) else read_header(data))
+  if command == "convert":
+    assert outfile and is_legacy(data)
+    with open(outfile, 'wb') as f:
+      f.write(convert_legacy(data))
+
+
+if __name__ == '__main__':
+  import sys
+  assert sys.argv[1] in ["info", "convert"] and sys.argv[2]
+  main(*sys.argv[1:])
@@ -0,0 +1,93 @@
+#include "pgn.hpp"
+
+namespace Pgn {
+
+bool Reader::next(string& text) {
+  text = pending;
+  pending.clear();
+  bool movetext = false;
+  string line;
+  while (std::getline(istr, line)) {
+    if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+    if (!line.empty() && line[0] == '[') {
+      if (movetext) { pending = line; break; } // Next game's tag
+    } else if (line.find_first_not_of(" \t") != string::npos) {
+      movetext = true;
+    }
+    text += line;
+    text += '\n';
+  }
+  return text.find_first_not_of(" \t\n") != string::npos;
+}
+
+Result parseResult(const string& s) {
+  if (s == "1-0") { return kWhiteWin; }
+  if (s == "0-1") { return kBlackWin; }
+  if (s == "1/2-1/2") { return kDraw; }
+  return kNoResult;
+}
+
+Game parseGame(const string& text) {
+  Game game;
+  size_t i = 0, n = text.size();
+  int variation_depth = 0;
+  string token;
+
+  auto flush = [&]() {
+    // Strip move number (e.g. "12." "12..." "12.e4")
+    size_t j = 0;
+    while (j < token.size() && std::isdigit(token[j])) { j++; }
+    if (j < token.size() && token[j] == '.') {
+      while (j < token.size() && token[j] == '.') { j++; }
+      token = token.substr(j);
+    }
+    if (!token.empty()) {
+      auto result = parseResult(token);
+      if (result != kNoResult || token == "*") {
+        if (game.result == kNoResult) { game.result = result; }
+      } else if (variation_depth == 0) {
+        game.moves.push_back(token);
+      }
+    }
+    token.clear();
+  };
+
+  while (i < n) {
+    char c = text[i];
+
+    // Tag pair
+    if (c == '[' && token.empty() && variation_depth == 0) {
+      size_t end = text.find(']', i);
+      if (end == string::npos) { break; }
+      auto tag = text.substr(i + 1, end - i - 1);
+      auto q1 = tag.find('"'), q2 = tag.rfind('"');
+      if (q1 != string::npos && q2 > q1) {
+        auto name = tag.substr(0, tag.find(' '));
+        auto value = tag.substr(q1 + 1, q2 - q1 - 1);
+        if (name == "Result") { game.result = parseResult(value); }
+        if (name == "FEN") { game.fen = value; }
+      }
+      i = end + 1;
+      continue;
+    }
+
+    // Comments
+    if (c == '{') { flush(); size_t end = text.find('}', i); i = (end == string::npos) ? n : end + 1; continue; }
+    if (c == ';') { flush(); size_t end = text.find('\n', i); i = (end == string::npos) ? n : end + 1; continue; }
+
+    // Variations
+    if (c == '(') { flush(); variation_depth++; i++; continue; }
+    if (c == ')') { flush(); variation_depth = std::max(0, variation_depth - 1); i++; continue; }
+
+    // NAG
+    if (c == '$') { flush(); while (i < n && !std::isspace(text[i])) { i++; } continue; }
+
+    if (std::isspace(c)) { flush(); i++; continue; }
+    token += c;
+    i++;
+  }
+  flush();
+  return game;
+}
+
+}; // namespace Pgn
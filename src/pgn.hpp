@@ -0,0 +1,32 @@
+#pragma once
+
+#include "base.hpp"
+
+//
+// Minimal PGN reader (tags except "Result" are ignored, comments/variations/NAGs are skipped)
+//
+
+namespace Pgn {
+
+enum Result { kWhiteWin, kBlackWin, kDraw, kNoResult };
+
+struct Game {
+  Result result = kNoResult;
+  vector<string> moves; // SAN
+  string fen; // "FEN" tag (empty if game starts from initial position)
+};
+
+// Split stream into texts of games without loading whole file
+struct Reader {
+  std::istream& istr;
+  string pending; // First tag line of next game
+
+  Reader(std::istream& istr_) : istr{istr_} {}
+
+  bool next(string& text); // False at the end of stream
+};
+
+Result parseResult(const string&);
+Game parseGame(const string& text);
+
+}; // namespace Pgn
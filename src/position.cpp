@@ -3,17 +3,33 @@
 
 using namespace precomputation;
 
+namespace {
+  // Castling rights lost when a piece moves from/to the square (i.e. king or rook initial squares)
+  const array<uint8_t, 64> kCastlingRightsMask = []() {
+    array<uint8_t, 64> res = {};
+    for (Color color = 0; color < 2; color++) {
+      for (CastlingSide side = 0; side < 2; side++) {
+        auto [king_from, _king_to, rook_from, _rook_to] = kCastlingMoves[color][side];
+        res[king_from] |= Position::State::toCastlingBit(color, side);
+        res[rook_from] |= Position::State::toCastlingBit(color, side);
+      }
+    }
+    return res;
+  }();
+};
+
 void Position::recompute(int level, [[maybe_unused]] bool temporary) {
   // init
   if (level >= 2) {
-    fillArray(piece_on, kNoPieceType);
+    fillArray(mailbox, kEmpty);
     for (Color color = 0; color < 2; color++) {
       occupancy[color] = 0;
       for (PieceType type = 0; type < 6; type++) {
         occupancy[color] |= pieces[color][type];
         for (auto sq : toSQ(pieces[color][type])) {
-          piece_on[color][sq] = type;
+          mailbox[sq] = toPieceCode(color, type);
           state->key ^= Zobrist::piece_squares[color][type][sq];
+          state->material_key += Endgame::toMaterialKey(color, type);
         }
       }
     }
@@ -25,12 +41,13 @@ void Position::recompute(int level, [[maybe_unused]] bool temporary) {
     }
     for (Color i = 0; i < 2; i++) {
       for (CastlingSide j = 0; j < 2; j++) {
-        if (state->castling_rights[i][j]) {
+        if (state->hasCastlingRight(i, j)) {
           state->key ^= Zobrist::castling_rights[i][j];
         }
       }
     }
     if (evaluator) { evaluator->initialize(*this); }
+    if (small_evaluator) { small_evaluator->initialize(*this); }
   }
 
   // init, makeMove, unmakeMove
@@ -72,13 +89,13 @@ void Position::setFen(const string& fen) {
   side_to_move = (s_side_to_move == "w") ? kWhite : kBlack;
 
   // Castling
-  state->castling_rights = {};
+  state->castling_rights = 0;
   if (s_castling_rights != "-") {
     for (auto c : s_castling_rights) {
-      if (c == 'K') { state->castling_rights[kWhite][kOO] = 1; }
-      if (c == 'Q') { state->castling_rights[kWhite][kOOO] = 1; }
-      if (c == 'k') { state->castling_rights[kBlack][kOO] = 1; }
-      if (c == 'q') { state->castling_rights[kBlack][kOOO] = 1; }
+      if (c == 'K') { state->castling_rights |= State::toCastlingBit(kWhite, kOO); }
+      if (c == 'Q') { state->castling_rights |= State::toCastlingBit(kWhite, kOOO); }
+      if (c == 'k') { state->castling_rights |= State::toCastlingBit(kBlack, kOO); }
+      if (c == 'q') { state->castling_rights |= State::toCastlingBit(kBlack, kOOO); }
     }
   }
 
@@ -106,7 +123,7 @@ array2<char, 8, 8> Position::toCharBoard() const {
       char mark = ' ';
       for (int color = 0; color < 2; color++) {
         if (occupancy[color] & toBB(sq)) {
-          mark = kFenPiecesMappingInverse[color][piece_on[color][sq]];
+          mark = kFenPiecesMappingInverse[color][pieceOn(color, sq)];
         }
       }
       res[i][j] = mark;
@@ -144,7 +161,7 @@ void Position::printFen(std::ostream& ostr) const {
   string s_castling;
   for (int color = 0; color < 2; color++) {
     for (int side = 0; side < 2; side++) {
-      if (state->castling_rights[color][side]) {
+      if (state->hasCastlingRight(color, side)) {
         s_castling += ("KQ"[side] + (color) * ('a' - 'A'));
       }
     }
@@ -166,6 +183,84 @@ void Position::printFen(std::ostream& ostr) const {
   ostr << ((game_ply / 2) + 1);
 }
 
+Move Position::parseSAN(const string& san) const {
+  // Strip check/annotation suffix
+  string s = san;
+  while (!s.empty() && string("+#!?").find(s.back()) != string::npos) { s.pop_back(); }
+  if (s.empty()) { return kNoneMove; }
+
+  MoveList moves;
+  generateMoves(moves);
+
+  if (s == "O-O" || s == "0-0" || s == "O-O-O" || s == "0-0-0") {
+    CastlingSide side = (s.size() == 3) ? kOO : kOOO;
+    for (auto move : moves) {
+      if (move.type() == kCastling && move.castlingSide() == side && isLegal(move)) { return move; }
+    }
+    return kNoneMove;
+  }
+
+  // Promotion suffix (e.g. "e8=Q" or "e8Q")
+  PieceType promotion = kNoPieceType;
+  if (s.size() >= 3 && string("NBRQ").find(s.back()) != string::npos) {
+    char c = s[s.size() - 2];
+    if (c == '=' || ('1' <= c && c <= '8')) {
+      promotion = kFenPiecesMapping[s.back()][1];
+      s.pop_back();
+      if (c == '=') { s.pop_back(); }
+    }
+  }
+
+  // Piece type, disambiguation and destination
+  PieceType type = kPawn;
+  if (string("NBRQK").find(s[0]) != string::npos) { type = kFenPiecesMapping[s[0]][1]; s = s.substr(1); }
+  if (s.size() < 2) { return kNoneMove; }
+  string to_str = s.substr(s.size() - 2);
+  if (!('a' <= to_str[0] && to_str[0] <= 'h' && '1' <= to_str[1] && to_str[1] <= '8')) { return kNoneMove; }
+  Square to = SQ::fromString(to_str);
+  File file = -1;
+  Rank rank = -1;
+  for (auto c : s.substr(0, s.size() - 2)) {
+    if ('a' <= c && c <= 'h') { file = c - 'a'; }
+    if ('1' <= c && c <= '8') { rank = c - '1'; }
+  }
+
+  Color own = side_to_move;
+  for (auto move : moves) {
+    if (move.to() != to || move.type() == kCastling) { continue; }
+    if (pieceOn(own, move.from()) != type) { continue; }
+    if (file != -1 && SQ::toFile(move.from()) != file) { continue; }
+    if (rank != -1 && SQ::toRank(move.from()) != rank) { continue; }
+    if ((move.type() == kPromotion ? move.promotionType() : kNoPieceType) != promotion) { continue; }
+    if (isLegal(move)) { return move; }
+  }
+  return kNoneMove;
+}
+
+Move Position::parseUCI(const string& s) const {
+  if (!(s.size() == 4 || s.size() == 5)) { return kNoneMove; }
+  for (int i : {0, 2}) {
+    if (!('a' <= s[i] && s[i] <= 'h' && '1' <= s[i + 1] && s[i + 1] <= '8')) { return kNoneMove; }
+  }
+  Square from = SQ::fromString(s.substr(0, 2));
+  Square to = SQ::fromString(s.substr(2, 2));
+
+  // Move type from moving piece
+  Move move(from, to);
+  PieceType type = pieceOn(side_to_move, from);
+  if (s.size() == 5) {
+    if (string("nbrq").find(s[4]) == string::npos) { return kNoneMove; }
+    move = Move(from, to, kPromotion, kFenPiecesMapping[s[4]][1]);
+  } else if (type == kPawn && (toBB(to) & kBackrankBB[!side_to_move])) {
+    return kNoneMove; // Missing promotion type
+  } else if (type == kKing && std::abs(to - from) == 2) {
+    move = Move(from, to, kCastling);
+  } else if (type == kPawn && (toBB(to) & state->ep_square)) {
+    move = Move(from, to, kEnpassant);
+  }
+  return (isPseudoLegal(move) && isLegal(move)) ? move : kNoneMove;
+}
+
 namespace {
   string toLichessURL(const string& fen) {
     string res = "https://lichess.org/editor/" + fen;
@@ -265,37 +360,52 @@ array<Board, 2> Position::getPawnCapture(Color own) const {
 //
 
 void Position::putPiece(Color color, PieceType type, Square sq, bool temporary) {
-  assert(piece_on[color][sq] == kNoPieceType);
+  assert(mailbox[sq] == kEmpty);
   pieces[color][type] ^= toBB(sq);
   occupancy[color] ^= toBB(sq);
-  piece_on[color][sq] = type;
+  mailbox[sq] = toPieceCode(color, type);
   state->key ^= Zobrist::piece_squares[color][type][sq];
+  state->material_key += Endgame::toMaterialKey(color, type);
   if (!temporary && evaluator) { evaluator->putPiece(color, type, sq); }
+  if (!temporary && small_evaluator) { small_evaluator->putPiece(color, type, sq); }
 }
 
 void Position::removePiece(Color color, Square sq, bool temporary) {
-  auto type = piece_on[color][sq];
+  auto type = pieceOn(color, sq);
   assert(type != kNoPieceType);
   pieces[color][type] ^= toBB(sq);
   occupancy[color] ^= toBB(sq);
-  piece_on[color][sq] = kNoPieceType;
+  mailbox[sq] = kEmpty;
   state->key ^= Zobrist::piece_squares[color][type][sq];
+  state->material_key -= Endgame::toMaterialKey(color, type);
   if (!temporary && evaluator) { evaluator->removePiece(color, type, sq); }
+  if (!temporary && small_evaluator) { small_evaluator->removePiece(color, type, sq); }
 }
 
 void Position::movePiece(Color color, Square from, Square to, bool temporary) {
-  auto type = piece_on[color][from];
+  auto type = pieceOn(color, from);
   removePiece(color, from, temporary);
   putPiece(color, type, to, temporary);
 }
 
+void Position::prefetchEvaluation(const Move& move) const {
+  if (!evaluator) { return; }
+  Color own = side_to_move, opp = !own;
+  auto from_type = typeOn(move.from());
+  auto to_type = pieceOn(opp, move.to());
+  evaluator->prefetch(own, from_type, move.from());
+  evaluator->prefetch(own, (move.type() == kPromotion) ? move.promotionType() : from_type, move.to());
+  if (to_type != kNoPieceType) { evaluator->prefetch(opp, to_type, move.to()); }
+  if (move.type() == kEnpassant) { evaluator->prefetch(opp, kPawn, move.capturedPawnSquare()); }
+}
+
 void Position::makeMove(const Move& move, bool temporary) {
   // Copy irreversible state
   pushState();
 
   Color own = side_to_move, opp = !own;
-  auto from_type = piece_on[own][move.from()];
-  auto to_type = state->to_piece_type = piece_on[opp][move.to()];
+  PieceType from_type = typeOn(move.from());
+  PieceType to_type = state->to_piece_type = pieceOn(opp, move.to());
   ASSERT(from_type != kNoPieceType);
 
   //
@@ -313,8 +423,8 @@ void Position::makeMove(const Move& move, bool temporary) {
 
   if (move.type() == kCastling) {
     auto [king_from, king_to, rook_from, rook_to] = kCastlingMoves[own][move.castlingSide()];
-    assert(piece_on[own][king_from] == kKing      && piece_on[own][rook_from] == kRook);
-    assert(piece_on[own][king_to] == kNoPieceType && piece_on[own][rook_to] == kNoPieceType);
+    assert(pieceOn(own, king_from) == kKing && pieceOn(own, rook_from) == kRook);
+    assert(mailbox[king_to] == kEmpty       && mailbox[rook_to] == kEmpty);
     movePiece(own, king_from, king_to, temporary);
     movePiece(own, rook_from, rook_to, temporary);
   }
@@ -326,7 +436,7 @@ void Position::makeMove(const Move& move, bool temporary) {
 
   if (move.type() == kEnpassant) {
     auto sq = move.capturedPawnSquare();
-    assert(piece_on[opp][sq] == kPawn);
+    assert(pieceOn(opp, sq) == kPawn);
     movePiece(own, move.from(), move.to(), temporary);
     removePiece(opp, sq, temporary);
   }
@@ -334,28 +444,10 @@ void Position::makeMove(const Move& move, bool temporary) {
   //
   // Castling rights
   //
-  if (from_type == kKing) {
-    for (auto side : {kOO, kOOO}) {
-      if (state->castling_rights[own][side]) {
-        state->castling_rights[own][side] = 0;
-        state->key ^= Zobrist::castling_rights[own][side];
-      }
-    }
-  }
-  if (from_type == kRook) {
-    for (auto side : {kOO, kOOO}) {
-      if (state->castling_rights[own][side] && move.from() == kCastlingMoves[own][side][2]) {
-        state->castling_rights[own][side] = 0;
-        state->key ^= Zobrist::castling_rights[own][side];
-      }
-    }
-  }
-  if (to_type == kRook) {
-    for (auto side : {kOO, kOOO}) {
-      if (state->castling_rights[opp][side] && move.to() == kCastlingMoves[opp][side][2]) {
-        state->castling_rights[opp][side] = 0;
-        state->key ^= Zobrist::castling_rights[opp][side];
-      }
+  if (uint8_t lost = state->castling_rights & (kCastlingRightsMask[move.from()] | kCastlingRightsMask[move.to()])) {
+    state->castling_rights ^= lost;
+    for (int bit = 0; bit < 4; bit++) {
+      if (lost & (1 << bit)) { state->key ^= Zobrist::castling_rights[bit / 2][bit % 2]; }
     }
   }
 
@@ -386,10 +478,9 @@ void Position::makeMove(const Move& move, bool temporary) {
   // Recompute states
   recompute(1, temporary);
 
-  // Reset evaluator on king move
-  if (!temporary && from_type == kKing && evaluator) {
-    evaluator->initialize(*this);
-  }
+  // Apply pending features at once (or refresh evaluator on king move)
+  if (!temporary && evaluator) { evaluator->update(*this); }
+  if (!temporary && small_evaluator) { small_evaluator->update(*this); }
 }
 
 void Position::unmakeMove(const Move& move, bool temporary) {
@@ -398,19 +489,14 @@ void Position::unmakeMove(const Move& move, bool temporary) {
   game_ply--;
 
   Color own = side_to_move, opp = !own;
-  auto from_type = piece_on[own][move.to()];
-  auto to_type = state->to_piece_type;
+  PieceType from_type = typeOn(move.to());
+  PieceType to_type = state->to_piece_type;
   ASSERT(from_type != kNoPieceType);
 
   //
   // put/remove/move pieces
   //
 
-  if (to_type != kNoPieceType) {
-    assert(to_type != kKing);
-    putPiece(opp, to_type, move.to(), temporary);
-  }
-
   if (move.type() == kNormal) {
     movePiece(own, move.to(), move.from(), temporary);
   }
@@ -432,16 +518,21 @@ void Position::unmakeMove(const Move& move, bool temporary) {
     movePiece(own, move.to(), move.from(), temporary);
   }
 
+  // Captured piece after own piece left the square (single mailbox)
+  if (to_type != kNoPieceType) {
+    assert(to_type != kKing);
+    putPiece(opp, to_type, move.to(), temporary);
+  }
+
   // Restore irreversible state (castling rights, en passant square, rule50)
   popState();
 
   // Recompute states
   recompute(0, temporary);
 
-  // Reset evaluator on king move
-  if (!temporary && from_type == kKing && evaluator) {
-    evaluator->initialize(*this);
-  }
+  // Apply pending features at once (or refresh evaluator on king move)
+  if (!temporary && evaluator) { evaluator->update(*this); }
+  if (!temporary && small_evaluator) { small_evaluator->update(*this); }
 }
 
 void Position::makeNullMove() {
@@ -474,15 +565,17 @@ void Position::unmakeNullMove() {
 
 bool Position::isDraw() const {
   // TODO: This ignores checkmate at 100th move
-  return state->rule50 >= 100 || isRepetition();
+  return state->rule50 >= 100 || isRepetition() || Endgame::isInsufficientMaterial(*this);
 }
 
 bool Position::isRepetition() const {
   // NOTE: False positive on key collision
+  int depth = state - &state_stack[0];
+  int num_keys = depth + key_history.size();
   for (int i = 2; ; i += 2) {
-    if (i > state->rule50) { break;}
-    if (state - i < &state_stack[0]) { break; }
-    if (state->key == (state - i)->key) { return true; }
+    if (i > state->rule50 || i > num_keys) { break; }
+    auto key = (i <= depth) ? (state - i)->key : key_history[num_keys - i];
+    if (state->key == key) { return true; }
   }
   return false;
 }
@@ -553,7 +646,7 @@ void Position::generateMoves(MoveList& move_list, MoveGenerationType movegen_typ
   // Castling
   if (!in_check && (movegen_type & kGenerateQuiet)) {
     for (auto side : {kOO, kOOO}) {
-      if (!state->castling_rights[own][side]) { continue; }
+      if (!state->hasCastlingRight(own, side)) { continue; }
       auto [king_from, king_to, rook_from, rook_to] = kCastlingMoves[own][side];
       if (in_between_table[king_from][rook_from] & occ) { continue; }
       move_list.put(Move(king_from, king_to, kCastling));
@@ -628,7 +721,7 @@ bool Position::isPseudoLegal(const Move& move) const {
   Board occ = occupancy[kBoth];
   Board target = ~occupancy[own];
 
-  auto from_type = piece_on[own][move.from()];
+  auto from_type = pieceOn(own, move.from());
 
   if (from_type == kNoPieceType) { return 0; }
   if (!(toBB(move.to()) & target)) { return 0; }
@@ -636,7 +729,7 @@ bool Position::isPseudoLegal(const Move& move) const {
   if (move.type() == kCastling) {
     if (from_type != kKing) { return 0; }
     auto side = move.castlingSide();
-    if (!state->castling_rights[own][side]) { return 0; }
+    if (!state->hasCastlingRight(own, side)) { return 0; }
     auto [king_from, king_to, rook_from, rook_to] = kCastlingMoves[own][side];
     if (in_between_table[king_from][rook_from] & occ) { return 0; }
     return 1;
@@ -693,7 +786,7 @@ bool Position::isLegal(const Move& move) const {
   Color own = side_to_move;
 
   Square king_sq = kingSQ(own);
-  bool is_king_move = (piece_on[own][move.from()] == kKing);
+  bool is_king_move = (pieceOn(own, move.from()) == kKing);
 
   //
   // Check evasion
@@ -771,7 +864,7 @@ Score Position::evaluateMove(const Move& move) {
   if (move.type() == kEnpassant) {
     victim = kPawn;
   } else {
-    victim = piece_on[!side_to_move][move.to()];
+    victim = pieceOn(!side_to_move, move.to());
   }
   if (victim == kNoPieceType) { return 0; }
 
@@ -788,8 +881,8 @@ Score Position::computeSEE(Square to, int depth) {
   Move move = getLVA(side_to_move, to);
   if (!move) { return 0; }
 
-  PieceType attacker = piece_on[side_to_move][move.from()];
-  PieceType attackee = piece_on[!side_to_move][to];
+  PieceType attacker = pieceOn(side_to_move, move.from());
+  PieceType attackee = pieceOn(!side_to_move, to);
   ASSERT(attacker != kNoPieceType);
   ASSERT(attackee != kNoPieceType);
   ASSERT(attackee != kKing);
@@ -846,7 +939,7 @@ bool Position::isCaptureOrPromotion(const Move& move) {
   return
     (move.type() == kEnpassant) ||
     (move.type() == kPromotion) ||
-    (piece_on[!side_to_move][move.to()] != kNoPieceType);
+    (pieceOn(!side_to_move, move.to()) != kNoPieceType);
 }
 
 bool Position::givesCheck(const Move& move) {
@@ -4,6 +4,7 @@
 #include "move.hpp"
 #include "precomputation.hpp"
 #include "transposition_table.hpp"
+#include "endgame.hpp"
 #include "nn/evaluator.hpp"
 
 //
@@ -16,20 +17,31 @@ struct Position {
   int game_ply = 0;
 
   array<Board, 3> occupancy = {}; // white/black/both
-  array2<PieceType, 2, 64> piece_on = {}; // 8x8 board representation
 
-  // Irreversible state when make/unmake move
-  struct State {
-    array2<bool, 2, 2> castling_rights = {}; // castling_rights[color][side]
-    Board ep_square = 0;
-    int rule50 = 0;
+  // 8x8 board representation (8 * color + type)
+  static inline constexpr uint8_t kEmpty = 8 * kBoth + kNoPieceType;
+  array<uint8_t, 64> mailbox = {};
+
+  static uint8_t toPieceCode(Color color, PieceType type) { return 8 * color + type; }
+  PieceType typeOn(Square sq) const { return mailbox[sq] & 7; } // kNoPieceType if empty
+  PieceType pieceOn(Color color, Square sq) const { return (mailbox[sq] >> 3) == color ? (mailbox[sq] & 7) : kNoPieceType; }
 
-    PieceType to_piece_type = kNoPieceType;
+  // Irreversible state when make/unmake move (copied per ply thus kept in one cache line)
+  struct alignas(64) State {
+    Zobrist::Key key = 0;
+    Endgame::MaterialKey material_key = 0; // Piece counts (cf. pieceCount)
     Board checkers = 0;
     Board blockers = 0;
+    Board ep_square = 0;
 
-    Zobrist::Key key = 0;
+    uint16_t rule50 = 0;
+    uint8_t castling_rights = 0; // Bit (2 * color + side)
+    uint8_t to_piece_type = kNoPieceType;
+
+    static uint8_t toCastlingBit(Color color, CastlingSide side) { return 1 << (2 * color + side); }
+    bool hasCastlingRight(Color color, CastlingSide side) const { return castling_rights & toCastlingBit(color, side); }
   };
+  static_assert(sizeof(State) == 64);
 
   State* state = nullptr;
   const static inline int kMaxDepth = 256;
@@ -39,16 +51,25 @@ struct Position {
     initialize(fen);
   }
 
+  // Keys of game positions before state_stack[0] (cf. isRepetition)
+  vector<Zobrist::Key> key_history;
+
   void initialize(const string& fen) {
     state = &state_stack[0];
     *state = {};
+    key_history.clear();
     setFen(fen);
     recompute(2);
   }
 
-  // Reset internal stack etc...
+  // Reset internal stack etc... (keys are moved to key_history so that game can go beyond kMaxDepth)
   void reset() {
+    auto keys = std::move(key_history);
+    for (auto s = &state_stack[0]; s < state; s++) { keys.push_back(s->key); }
+    int rule50 = state->rule50;
     initialize(toFen());
+    if ((int)keys.size() > rule50) { keys.erase(keys.begin(), keys.end() - rule50); } // Older positions can't repeat
+    key_history = std::move(keys);
   }
 
   void pushState() {
@@ -73,6 +94,8 @@ struct Position {
   string toFen() const;
   array2<char, 8, 8> toCharBoard() const;
   void printFen(std::ostream&) const;
+  Move parseSAN(const string&) const; // Standard algebraic notation e.g. "Nbxd7+" (kNoneMove if not legal)
+  Move parseUCI(const string&) const; // e.g. "e1g1" "a7a8q" (kNoneMove if not legal)
   void print(std::ostream& ostr = std::cerr) const;
   friend std::ostream& operator<<(std::ostream& ostr, const Position& self) { self.print(ostr); return ostr; }
 
@@ -80,6 +103,7 @@ struct Position {
   // Utility
   //
   Square kingSQ(Color color) const { return toSQ(pieces[color][kKing]).front(); }
+  int pieceCount(Color color, PieceType type) const { return Endgame::getCount(state->material_key, color, type); }
   Board getAttackers(Color, Square, Board removed = 0) const;
   Board getBlockers(Color, Square) const;
   bool isPinned(Color, Square, Square, Square, Board) const;
@@ -119,11 +143,21 @@ struct Position {
   // Evaluation
   //
   nn::Evaluator* evaluator = nullptr;
+  nn::Evaluator* small_evaluator = nullptr; // Optional cheaper network (cf. Engine::evaluate)
+
+  // Start loading evaluator's rows affected by the move before making it (cf. MovePicker::getNext)
+  void prefetchEvaluation(const Move&) const;
 
   // Score for side_to_move
-  Score evaluate() const {
-    ASSERT(evaluator);
-    Score res = evaluator->evaluate();
+  Score evaluate(bool small = false) const {
+    // Trivial endgames don't need network
+    if (auto entry = Endgame::probe(state->material_key)) {
+      Score res = entry->handler(*this, entry->strong);
+      return side_to_move == entry->strong ? res : -res;
+    }
+    auto e = small ? small_evaluator : evaluator;
+    ASSERT(e);
+    Score res = e->evaluate();
     if (side_to_move == kBlack) { res *= -1; }
     res += kTempo;
     return res;
@@ -134,3 +134,75 @@ TEST_CASE("Position::isRepetition") {
   pos.makeMove(Move(kH5, kD1));
   CHECK(pos.isRepetition() == true);
 }
+
+TEST_CASE("Position::State::material_key") {
+  // Capture and promotion
+  auto fen = "1n2k3/P7/8/8/8/8/8/4K3 w - - 0 1";
+  Position pos(fen);
+  CHECK(pos.state->material_key == Endgame::fromCode("KPvKN"));
+  Move move(kA7, kB8, kPromotion, kQueen);
+  pos.makeMove(move);
+  CHECK(pos.state->material_key == Endgame::fromCode("KQvK"));
+  CHECK(pos.state->material_key == Position(pos.toFen()).state->material_key);
+  CHECK(pos.pieceCount(kWhite, kQueen) == 1);
+  CHECK(pos.pieceCount(kBlack, kKnight) == 0);
+  pos.unmakeMove(move);
+  CHECK(pos.state->material_key == Endgame::fromCode("KPvKN"));
+}
+
+TEST_CASE("Position::isDraw (insufficient material)") {
+  vector<pair<string, bool>> cases = {
+    {"8/8/4k3/8/8/2K5/8/8 w - - 0 1", true}, // KvK
+    {"8/8/4k3/8/8/2K5/3N4/8 w - - 0 1", true}, // KNvK
+    {"8/8/3bk3/8/8/2K5/3B4/8 w - - 0 1", true}, // KBvKB (same color)
+    {"8/8/2b1k3/8/8/2K5/3B4/8 w - - 0 1", false}, // KBvKB (opposite color)
+    {"8/8/4k3/8/8/2K5/3NN3/8 w - - 0 1", false}, // KNNvK
+    {"8/8/4k3/8/8/2K5/3P4/8 w - - 0 1", false}, // KPvK
+  };
+  for (auto [fen, expected] : cases) {
+    CHECK(Position(fen).isDraw() == expected);
+  }
+}
+
+TEST_CASE("Position::evaluate (endgame)") {
+  // No network is needed
+  CHECK(Position("8/8/4k3/8/8/2K5/3NN3/8 w - - 0 1").evaluate() == kScoreDraw);
+  CHECK(Position("8/8/4k3/8/8/2K5/3R4/8 w - - 0 1").evaluate() >= Endgame::kScoreKnownWin);
+  CHECK(Position("8/8/4k3/8/8/2K5/3R4/8 b - - 0 1").evaluate() <= -Endgame::kScoreKnownWin);
+  CHECK(Position("8/8/4k3/8/8/2K5/3r4/8 b - - 0 1").evaluate() >= Endgame::kScoreKnownWin);
+
+  // Minor piece each is close to draw but not exact (mate is possible with king in the corner)
+  CHECK(Position("8/8/3bk3/8/8/2K5/3B4/8 w - - 0 1").evaluate() == kScoreDraw); // KBvKB (same color)
+  for (auto fen : {"8/8/2b1k3/8/8/2K5/3B4/8 w - - 0 1", "8/8/4k3/8/8/2K5/3N4/5b2 w - - 0 1", "8/8/4k3/8/8/2K5/3N4/5n2 w - - 0 1"}) {
+    CHECK(std::abs(Position(fen).evaluate()) < 50);
+  }
+  CHECK(Position("k7/8/8/8/8/2K5/3N4/5n2 w - - 0 1").evaluate() > 0); // KNvKN with black king cornered
+
+  // King closer to the edge is worse
+  CHECK(Position("7k/8/8/8/8/2K5/3R4/8 w - - 0 1").evaluate() > Position("8/8/4k3/8/8/2K5/3R4/8 w - - 0 1").evaluate());
+}
+
+TEST_CASE("Position::parseSAN") {
+  Position pos("r3k2r/1P1n4/8/8/8/1N3N2/8/R3K2R w KQkq - 0 1");
+  CHECK(pos.parseSAN("Nbd4") == Move(kB3, kD4));
+  CHECK(pos.parseSAN("Nfd4+") == Move(kF3, kD4));
+  CHECK(pos.parseSAN("O-O") == Move(kE1, kG1, kCastling));
+  CHECK(pos.parseSAN("O-O-O") == Move(kE1, kC1, kCastling));
+  CHECK(pos.parseSAN("bxa8=Q#") == Move(kB7, kA8, kPromotion, kQueen));
+  CHECK(pos.parseSAN("b8N") == Move(kB7, kB8, kPromotion, kKnight));
+  CHECK(pos.parseSAN("b8") == kNoneMove);
+  CHECK(pos.parseSAN("Ke3") == kNoneMove);
+  CHECK(pos.parseSAN("xyz") == kNoneMove);
+}
+
+TEST_CASE("Position::parseUCI") {
+  Position pos("r3k2r/1P6/8/3pP3/8/8/8/R3K2R w KQkq d6 0 1");
+  CHECK(pos.parseUCI("e1g1") == Move(kE1, kG1, kCastling));
+  CHECK(pos.parseUCI("e1c1") == Move(kE1, kC1, kCastling));
+  CHECK(pos.parseUCI("e5d6") == Move(kE5, kD6, kEnpassant));
+  CHECK(pos.parseUCI("b7a8n") == Move(kB7, kA8, kPromotion, kKnight));
+  CHECK(pos.parseUCI("b7b8") == kNoneMove);
+  CHECK(pos.parseUCI("e1e3") == kNoneMove);
+  CHECK(pos.parseUCI("e8d8") == kNoneMove);
+  CHECK(pos.parseUCI("e1") == kNoneMove);
+}
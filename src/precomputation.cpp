@@ -1,5 +1,8 @@
 #include "precomputation.hpp"
 #include <config.hpp>
+#if defined(__x86_64__)
+  #include <cpuid.h>
+#endif
 
 namespace precomputation {
 
@@ -19,6 +22,49 @@ namespace precomputation {
   array<Magic, 64> bishop_magic_table = {};
   vector<Board> rook_attack_table = {};
   vector<Board> bishop_attack_table = {};
+#if defined(__BMI2__)
+  bool use_pext = true;
+#else
+  bool use_pext = false;
+#endif
+
+  // Found by searchMagic (cf. "precomputation::searchMagic" test)
+  const array<uint64_t, 64> kRookMagics = {
+    0x0b800040018012a0ULL, 0x80c0100020004004ULL, 0x0280100020008008ULL, 0x0200082042001004ULL,
+    0x8500080011000204ULL, 0x4080010400800200ULL, 0x0080008001000200ULL, 0x4080003c40800100ULL,
+    0x0000800020804002ULL, 0x2000808040002000ULL, 0x0000802000801000ULL, 0x0022000a04401020ULL,
+    0x8000800400080080ULL, 0x1488800200040080ULL, 0x2002000401020008ULL, 0x4402001202a04504ULL,
+    0x9040018022408000ULL, 0x0850810020400500ULL, 0x8040110020010044ULL, 0x0101010010002008ULL,
+    0x0048828004004800ULL, 0x0904808004000200ULL, 0x4480040022302821ULL, 0x80004e0004048041ULL,
+    0x1080004040002015ULL, 0x0100400180200080ULL, 0x0010200080100084ULL, 0x1000100480080080ULL,
+    0x0800040080800800ULL, 0x8008020080040080ULL, 0x000c100400024108ULL, 0xa010109200004104ULL,
+    0x0a40002040800080ULL, 0x0004200042401002ULL, 0x0010100080802000ULL, 0x0390001680800800ULL,
+    0x002200040a001020ULL, 0x0002040080800200ULL, 0x0288082954001006ULL, 0x5020012082001044ULL,
+    0x8888400098208000ULL, 0xa000201006444002ULL, 0x0218200010008080ULL, 0x0610081001010020ULL,
+    0x1000080004008080ULL, 0x0002001008020004ULL, 0x1001000200010004ULL, 0x6004c04400820001ULL,
+    0x2000304201008200ULL, 0x1000802000401080ULL, 0x0120002480100480ULL, 0x0000100008008280ULL,
+    0x0020040008008080ULL, 0x0010040002008080ULL, 0x8000502228014400ULL, 0x009000804c210200ULL,
+    0x4000102081004202ULL, 0x2200110080400021ULL, 0x0011002000400811ULL, 0x0a81200884900101ULL,
+    0x0022002088041102ULL, 0xc085000400088201ULL, 0x00010004d2000425ULL, 0x0080010040208402ULL
+  };
+  const array<uint64_t, 64> kBishopMagics = {
+    0x1311021004008810ULL, 0x0060014401204200ULL, 0x8042008501000000ULL, 0x0409040100000201ULL,
+    0x0021104010000140ULL, 0x0606084414400020ULL, 0x40040d0110b01020ULL, 0x2003030806030490ULL,
+    0x8800088208080100ULL, 0x810b080214040228ULL, 0x0400102102002088ULL, 0x003004410220c840ULL,
+    0x02124c0420000880ULL, 0x0840110422c00840ULL, 0x000d140449141041ULL, 0x0080060442423007ULL,
+    0x104040101c01c401ULL, 0x0802080408020406ULL, 0x0002003000820008ULL, 0x0a02000420220000ULL,
+    0x80120204010c0a20ULL, 0x1022008110422000ULL, 0x5000820104016000ULL, 0x1000200204942404ULL,
+    0x2104c18004900400ULL, 0x0042108012101224ULL, 0x008298021001a022ULL, 0x2022080090081020ULL,
+    0x2010101001004000ULL, 0x1410002000441008ULL, 0x1d04010824250521ULL, 0x0208488001088804ULL,
+    0x7008084200080203ULL, 0x0028411008041408ULL, 0x0100280401080020ULL, 0x00a8a00500080090ULL,
+    0x80a4040400801010ULL, 0x0030020080081040ULL, 0x0002109600410841ULL, 0x0434040a30004300ULL,
+    0x0289082005001082ULL, 0x081888a860002810ULL, 0x0201414020801008ULL, 0x8200104200801808ULL,
+    0x8022400091040200ULL, 0x0041200800401080ULL, 0x0044010204100200ULL, 0x02101081010022c2ULL,
+    0x2004161a10048800ULL, 0x04c2020084452402ULL, 0x0000004200902212ULL, 0x0102009484110000ULL,
+    0x0000081082020451ULL, 0x40014030020220c1ULL, 0x02092001820a0080ULL, 0x4808300900410404ULL,
+    0x8010410800a22003ULL, 0x0282010104822010ULL, 0x0100880202011440ULL, 0x1d21180080420a03ULL,
+    0x021424e010020214ULL, 0x8054200882080205ULL, 0x0000180a24980200ULL, 0x4102100c00840042ULL
+  };
 
   // Auto initialize on startup
   struct RunOnStartup {
@@ -96,85 +142,83 @@ namespace precomputation {
     }
   }
 
+  // Relevant occupancy (boundary occupancy doesn't change attack)
   template<class F>
-  void generateMagicTable(array<Magic, 64>& magic_table, F getAttack) {
+  Board getMagicMask(Square sq, F getAttack) {
     const Board fileAH = BB::fromFile(kFileA) | BB::fromFile(kFileH);
     const Board rank18 = BB::fromRank(kRank1) | BB::fromRank(kRank8);
+    auto [file, rank] = SQ::toCoords(sq);
+    Board edge = (fileAH & ~BB::fromFile(file)) | (rank18 & ~BB::fromRank(rank));
+    return getAttack(sq, Board(0)) & ~edge;
+  }
 
-    for (Square sq = 0; sq < 64; sq++) {
-      // Sliding attack in empty board
-      Board mask = getAttack(sq, Board(0));
-
-      // Boundary occupancy is irrelavant
-      auto [file, rank] = SQ::toCoords(sq);
-      Board edge = (fileAH & ~BB::fromFile(file)) | (rank18 & ~BB::fromRank(rank));
-      mask &= ~edge;
-
-      int mask_popcnt = toSQ(mask).size();
-      assert(5 <= mask_popcnt && mask_popcnt <= 12);
-
-      // Enumerate all relavant occupancy configuration
-      vector<array<uint64_t, 2>> mapping;
-      for (Board occ = 0; ;) {
-        mapping.push_back({occ, getAttack(sq, occ)});
-        occ = (occ - mask) & mask;
-        if (occ == 0) { break; }
-      }
-      assert(mapping.size() == (1 << mask_popcnt));
-
-      // NOTE: For debug build, allow one more bit to make it easier to find magic (otherwise it's too slow)
-      int n = mask_popcnt + (kBuildType == "Debug");
-
-      Magic& m = magic_table[sq];
-      m.mask = mask;
-      m.shift = 64 - n;
-
-      const int num_trial = 1 << 20;
-      Rng rng;
-
-      const uint64_t not_used = -1;
-      vector<uint64_t> table(1 << n);
+  template<class F>
+  uint64_t searchMagicImpl(Square sq, F getAttack, Rng& rng) {
+    Board mask = getMagicMask(sq, getAttack);
+    int n = toSQ(mask).size();
+    ASSERT(5 <= n && n <= 12);
+
+    // Enumerate all relavant occupancy configuration
+    vector<array<uint64_t, 2>> mapping;
+    for (Board occ = 0; ;) {
+      mapping.push_back({occ, getAttack(sq, occ)});
+      occ = (occ - mask) & mask;
+      if (occ == 0) { break; }
+    }
+    ASSERT(mapping.size() == (size_t(1) << n));
 
-      bool found = 0;
-      for (int i = 0; i < num_trial; i++) {
-        // Look for "promising magic"
-        m.magic = 0;
-        while (__builtin_popcountll(m.index(mask)) < n - 2) {
-          // Generate sparse bits
-          m.magic = rng.next64() & rng.next64() & rng.next64();
-        }
+    Magic m;
+    m.mask = mask;
+    m.shift = 64 - n;
 
-        // Check if this magic produces conflict
-        table.assign(1 << n, not_used);
+    const uint64_t not_used = -1;
+    vector<uint64_t> table(1 << n);
+    while (true) {
+      // Look for "promising magic"
+      m.magic = 0;
+      while (__builtin_popcountll(m.magicIndex(mask)) < n - 2) {
+        // Generate sparse bits
+        m.magic = rng.next64() & rng.next64() & rng.next64();
+      }
 
-        bool conflict = 0;
-        for (auto [k, v] : mapping) {
-          uint64_t h = m.index(k);
-          if (table[h] != not_used && table[h] != v) { conflict = 1; break; }
-          table[h] = v;
-        }
-        if (!conflict) { found = 1; break; }
+      // Check if this magic produces conflict
+      table.assign(1 << n, not_used);
+      bool conflict = 0;
+      for (auto [k, v] : mapping) {
+        uint64_t h = m.magicIndex(k);
+        if (table[h] != not_used && table[h] != v) { conflict = 1; break; }
+        table[h] = v;
       }
-      assert(found);
+      if (!conflict) { return m.magic; }
     }
   }
 
   template<class F>
-  void generateMagicAttackTable(array<Magic, 64>& magic_table, vector<Board>& attack_table, F getAttack) {
+  void generateMagicAttackTable(array<Magic, 64>& magic_table, vector<Board>& attack_table, const array<uint64_t, 64>& magics, F getAttack) {
+    // Minimal index bits for each square
+    for (Square sq = 0; sq < 64; sq++) {
+      auto& m = magic_table[sq];
+      m.mask = getMagicMask(sq, getAttack);
+      m.magic = magics[sq];
+      m.shift = 64 - toSQ(m.mask).size();
+    }
+
     // First allocate for all squares to avoid vector reallocation
     int total_size = 0;
     for (int sq = 0; sq < 64; sq++) {
       auto& m = magic_table[sq];
       total_size += (1 << (64 - m.shift));
     }
-    attack_table.resize(total_size);
+    attack_table.assign(total_size, Board(0));
 
     // Set pointer to each square's offset
     for (int sq = 0, offset = 0; sq < 64; sq++) {
       auto& m = magic_table[sq];
       m.table = &attack_table[offset];
       for (Board occ = 0; ; ) {
-        m.table[m.index(occ)] = getAttack(sq, occ);
+        Board attack = getAttack(sq, occ);
+        ASSERT(!m.table[m.index(occ)] || m.table[m.index(occ)] == attack); // Bad magic
+        m.table[m.index(occ)] = attack;
         occ = (occ - m.mask) & m.mask;
         if (occ == 0) { break; }
       }
@@ -182,13 +226,42 @@ namespace precomputation {
     }
   }
 
+  Board rookRays(Square sq, Board occ) { return getRays(sq, kRookDirs, occ); }
+  Board bishopRays(Square sq, Board occ) { return getRays(sq, kBishopDirs, occ); }
+
+#if defined(__x86_64__)
+  // PEXT is microcoded on AMD before Zen 3 (family 19h) and much slower than magic multiplication
+  bool hasFastPext() {
+    __builtin_cpu_init(); // Might run before other static constructors
+    if (!__builtin_cpu_supports("bmi2")) { return false; }
+    if (!__builtin_cpu_is("amd")) { return true; }
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) { return false; }
+    unsigned family = (eax >> 8) & 0xf;
+    if (family == 0xf) { family += (eax >> 20) & 0xff; }
+    return family >= 0x19;
+  }
+#endif
+
   void initializeMagicTables() {
-    auto rookAttack = [&](Square sq, Board occ) -> Board { return getRays(sq, kRookDirs, occ); };
-    auto bishopAttack = [&](Square sq, Board occ) -> Board { return getRays(sq, kBishopDirs, occ); };
-    generateMagicTable(rook_magic_table, rookAttack);
-    generateMagicTable(bishop_magic_table, bishopAttack);
-    generateMagicAttackTable(rook_magic_table, rook_attack_table, rookAttack);
-    generateMagicAttackTable(bishop_magic_table, bishop_attack_table, bishopAttack);
+#if defined(__x86_64__)
+    initializeMagicTables(hasFastPext());
+#else
+    initializeMagicTables(false);
+#endif
+  }
+
+  void initializeMagicTables(bool pext) {
+#if defined(__BMI2__)
+    ASSERT(pext);
+#endif
+    use_pext = pext;
+    generateMagicAttackTable(rook_magic_table, rook_attack_table, kRookMagics, rookRays);
+    generateMagicAttackTable(bishop_magic_table, bishop_attack_table, kBishopMagics, bishopRays);
+  }
+
+  uint64_t searchMagic(Square sq, bool rook, Rng& rng) {
+    return rook ? searchMagicImpl(sq, rookRays, rng) : searchMagicImpl(sq, bishopRays, rng);
   }
 
   //
@@ -208,13 +281,4 @@ namespace precomputation {
     return ray;
   }
 
-  Board getMagicAttack(Square from, Board occ, const array<Magic, 64>& magic_table) {
-    Magic m = magic_table[from];
-    return m.table[m.index(occ)];
-  }
-
-  Board getBishopAttack(Square from, Board occ) { return getMagicAttack(from, occ, bishop_magic_table); }
-  Board getRookAttack(Square from, Board occ)   { return getMagicAttack(from, occ, rook_magic_table); }
-  Board getQueenAttack(Square from, Board occ)  { return getRookAttack(from, occ) | getBishopAttack(from, occ); }
-
 } // namespace precomputation
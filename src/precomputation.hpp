@@ -2,6 +2,10 @@
 
 #include "base.hpp"
 
+#if defined(__BMI2__)
+  #include <immintrin.h>
+#endif
+
 namespace precomputation {
 
   //
@@ -19,24 +23,59 @@ namespace precomputation {
   extern array<Board, 64> knight_attack_table;
   extern array2<Board, 2, 64> pawn_attack_table; // Capture for white/black
 
-  // Magic sliding piece attack table
-  struct Magic {
+  // BMI2 parallel bits extract (without compiling whole program with -mbmi2)
+  inline uint64_t pext(uint64_t x, uint64_t mask) {
+#if defined(__BMI2__)
+    return _pext_u64(x, mask);
+#elif defined(__x86_64__)
+    uint64_t res;
+    asm("pextq %2, %1, %0" : "=r"(res) : "r"(x), "r"(mask));
+    return res;
+#else
+    ASSERT(0);
+    return 0;
+#endif
+  }
+
+  // Detected on startup (always if built with -mbmi2)
+  extern bool use_pext;
+
+  // Sliding piece attack table indexed by magic multiplication or PEXT (same table size)
+  struct alignas(32) Magic {
     Board* table;
-    uint64_t magic, mask;
-    int shift;
-    uint64_t index(uint64_t occ) { return ((occ & mask) * magic) >> shift; };
+    uint64_t mask;
+    uint64_t magic;
+    uint32_t shift;
+    uint64_t magicIndex(uint64_t occ) const { return ((occ & mask) * magic) >> shift; }
+    uint64_t pextIndex(uint64_t occ) const { return pext(occ, mask); }
+    uint64_t index(uint64_t occ) const {
+#if defined(__BMI2__)
+      return pextIndex(occ);
+#else
+      return use_pext ? pextIndex(occ) : magicIndex(occ);
+#endif
+    }
   };
+  static_assert(sizeof(Magic) == 32); // Two squares per cache line
   extern array<Magic, 64> rook_magic_table;
   extern array<Magic, 64> bishop_magic_table;
   extern vector<Board> rook_attack_table;
   extern vector<Board> bishop_attack_table;
   extern bool is_magic_ready;
 
+  // Pre-generated magic numbers with minimal index bits (so startup doesn't search)
+  extern const array<uint64_t, 64> kRookMagics;
+  extern const array<uint64_t, 64> kBishopMagics;
+
   void initializeTables();
   void generateDistanceTable();
   void generateInBetweenTable();
   void generateNonSlidingAttackTables();
   void initializeMagicTables();
+  void initializeMagicTables(bool pext); // Choose backend explicitly (e.g. for benchmark)
+
+  // Random trials until magic without conflict (only to regenerate kRookMagics/kBishopMagics)
+  uint64_t searchMagic(Square, bool rook, Rng&);
 
   //
   // Attack squares
@@ -51,8 +90,13 @@ namespace precomputation {
     return b;
   }
 
-  Board getBishopAttack(Square, Board);
-  Board getRookAttack(Square, Board);
-  Board getQueenAttack(Square, Board);
+  inline Board getMagicAttack(Square from, Board occ, const array<Magic, 64>& magic_table) {
+    const Magic& m = magic_table[from];
+    return m.table[m.index(occ)];
+  }
+
+  inline Board getBishopAttack(Square from, Board occ) { return getMagicAttack(from, occ, bishop_magic_table); }
+  inline Board getRookAttack(Square from, Board occ)   { return getMagicAttack(from, occ, rook_magic_table); }
+  inline Board getQueenAttack(Square from, Board occ)  { return getRookAttack(from, occ) | getBishopAttack(from, occ); }
 
 } // namespace precomputation
@@ -0,0 +1,63 @@
+#include "precomputation.hpp"
+#include "timeit.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+using namespace precomputation;
+
+TEST_CASE("precomputation::initializeTables") {
+  // Startup cost
+  SECTION("initializeTables") {
+    INFO(timeit::timeit([&]() {
+      initializeTables();
+      return rook_attack_table[0];
+    }, 1, 8));
+    SUCCEED();
+  }
+
+  // Previous startup cost (for comparison)
+  SECTION("searchMagic") {
+    INFO(timeit::timeit([&]() {
+      Rng rng;
+      uint64_t res = 0;
+      for (Square sq = 0; sq < 64; sq++) {
+        res ^= searchMagic(sq, true, rng) ^ searchMagic(sq, false, rng);
+      }
+      return res;
+    }, 1, 8));
+    SUCCEED();
+  }
+}
+
+TEST_CASE("precomputation::getQueenAttack") {
+  Rng rng;
+  vector<pair<Square, Board>> inputs(1 << 12);
+  for (auto& [sq, occ] : inputs) { sq = rng.next() % 64; occ = rng.next64() & rng.next64(); }
+
+  auto run = [&]() {
+    Board res = 0;
+    for (auto [sq, occ] : inputs) { res ^= getQueenAttack(sq, occ); }
+    return res;
+  };
+
+  // Switch backend for the section and restore default
+  auto bench = [&](bool pext) {
+    bool default_pext = use_pext;
+    initializeMagicTables(pext);
+    auto res = timeit::timeit(run);
+    initializeMagicTables(default_pext);
+    return res;
+  };
+
+#if !defined(__BMI2__)
+  SECTION("magic") {
+    INFO(bench(false));
+    SUCCEED();
+  }
+#endif
+
+  SECTION("pext") {
+    if (!__builtin_cpu_supports("bmi2")) { SUCCEED(); return; }
+    INFO(bench(true));
+    SUCCEED();
+  }
+}
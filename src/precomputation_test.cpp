@@ -73,3 +73,46 @@ TEST_CASE("precomputation::generateNonSlidingAttackTables") {
     CHECK(BB(pawn_attack_table[kWhite][from]).toString(0) == expected);
   }
 }
+
+TEST_CASE("precomputation::searchMagic") {
+  // Shipped magics agree with ray attack
+  Rng rng;
+  int num_errors = 0;
+  for (Square sq = 0; sq < 64; sq++) {
+    for (int i = 0; i < 256; i++) {
+      Board occ = rng.next64() & rng.next64();
+      num_errors += getRookAttack(sq, occ) != getRays(sq, kRookDirs, occ);
+      num_errors += getBishopAttack(sq, occ) != getRays(sq, kBishopDirs, occ);
+    }
+  }
+  CHECK(num_errors == 0);
+
+  // Minimal index bits
+  CHECK(rook_attack_table.size() == 102400);
+  CHECK(bishop_attack_table.size() == 5248);
+
+  // Search is deterministic (kRookMagics/kBishopMagics are generated by this sequence)
+  Rng rng2;
+  CHECK(searchMagic(kA1, /* rook */ true, rng2) == kRookMagics[kA1]);
+}
+
+TEST_CASE("precomputation::initializeMagicTables") {
+  // Both backends give same attacks
+  Rng rng;
+  int num_errors = 0;
+  bool default_pext = use_pext;
+  for (bool pext : {false, true}) {
+#if defined(__BMI2__)
+    if (!pext) { continue; }
+#endif
+    if (pext && !__builtin_cpu_supports("bmi2")) { continue; }
+    initializeMagicTables(pext);
+    for (int i = 0; i < 1 << 14; i++) {
+      Square sq = rng.next() % 64;
+      Board occ = rng.next64() & rng.next64();
+      num_errors += getQueenAttack(sq, occ) != (getRays(sq, kRookDirs, occ) | getRays(sq, kBishopDirs, occ));
+    }
+  }
+  initializeMagicTables(default_pext);
+  CHECK(num_errors == 0);
+}
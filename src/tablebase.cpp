@@ -0,0 +1,455 @@
+#include "tablebase.hpp"
+#include "position.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace precomputation;
+
+namespace {
+
+// Index of a1-d1-d4 triangle (-1 outside)
+const array<int, 64> kTriangleIndex = []() {
+  array<int, 64> res;
+  res.fill(-1);
+  int i = 0;
+  for (Rank rank = kRank1; rank <= kRank4; rank++) {
+    for (File file = rank; file <= kFileD; file++) { res[SQ::fromCoords(file, rank)] = i++; }
+  }
+  return res;
+}();
+
+Square transpose(Square sq) { return SQ::fromCoords(SQ::toRank(sq), SQ::toFile(sq)); }
+
+size_t power64(int n) { return size_t(1) << (6 * n); }
+
+// Same conditions as Table's constructor asserts (for code read from file)
+bool isValidCode(const string& code) {
+  int num_pieces = 0;
+  for (auto c : code) {
+    if (c == 'v') { continue; }
+    if (!kFenPiecesMapping.count(c)) { return false; }
+    num_pieces++;
+  }
+  return 2 <= num_pieces && num_pieces <= Tablebase::kMaxPieces && code[0] == 'K';
+}
+
+}; // namespace
+
+//
+// Table
+//
+
+Tablebase::Table::Table(const string& code_) : code{code_} {
+  Color color = kWhite;
+  for (auto c : code) {
+    if (c == 'v') { color = kBlack; continue; }
+    ASSERT(kFenPiecesMapping.count(c));
+    PieceType type = kFenPiecesMapping[c][1];
+    pieces.push_back({color, type});
+    has_pawns = has_pawns || (type == kPawn);
+  }
+  ASSERT(2 <= (int)pieces.size() && (int)pieces.size() <= kMaxPieces);
+  ASSERT((pieces[0] == pair<Color, PieceType>{kWhite, kKing}));
+}
+
+Tablebase::Table::~Table() {
+  if (mapped) { munmap(mapped, mapped_size); }
+}
+
+size_t Tablebase::Table::getSize(int num_pieces, bool has_pawns) {
+  return (has_pawns ? 32 : 10) * power64(num_pieces - 1) * 2;
+}
+
+size_t Tablebase::Table::getIndex(array<Square, kMaxPieces> squares, Color side_to_move) const {
+  int n = pieces.size();
+  auto apply = [&](auto f) { for (int i = 0; i < n; i++) { squares[i] = f(squares[i]); } };
+  if (SQ::toFile(squares[0]) > kFileD) { apply(SQ::flipFile); }
+
+  size_t index;
+  if (has_pawns) {
+    index = SQ::toRank(squares[0]) * 4 + SQ::toFile(squares[0]);
+  } else {
+    if (SQ::toRank(squares[0]) > kRank4) { apply(SQ::flipRank); }
+    if (SQ::toRank(squares[0]) > SQ::toFile(squares[0])) { apply(transpose); }
+    index = kTriangleIndex[squares[0]];
+  }
+  ASSERT_HOT(index < (has_pawns ? 32U : 10U));
+  for (int i = 1; i < n; i++) { index = index * 64 + squares[i]; }
+  return index * 2 + side_to_move;
+}
+
+std::unique_ptr<Tablebase::Table> Tablebase::Table::fromFile(const string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) { return nullptr; }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(Header)) { close(fd); return nullptr; }
+  size_t file_size = st.st_size;
+  void* ptr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) { return nullptr; }
+
+  auto& header = *reinterpret_cast<const Header*>(ptr);
+  string code(header.code, strnlen(header.code, sizeof(header.code)));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || !isValidCode(code)) {
+    munmap(ptr, file_size);
+    return nullptr;
+  }
+  auto table = std::make_unique<Table>(code);
+  table->mapped = ptr; // Unmapped by destructor from here
+  table->mapped_size = file_size;
+  if (table->pieces.size() != header.num_pieces) { return nullptr; }
+  if (header.size != getSize(header.num_pieces, table->has_pawns)) { return nullptr; }
+  if (file_size != sizeof(Header) + header.size) { return nullptr; } // e.g. truncated
+  table->max_dtm = header.max_dtm;
+  table->data = reinterpret_cast<const uint8_t*>(ptr) + sizeof(Header);
+  table->size = header.size;
+  return table;
+}
+
+void Tablebase::Table::save(const string& filename) const {
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_pieces = pieces.size();
+  ASSERT(code.size() < sizeof(header.code));
+  std::memcpy(header.code, code.data(), code.size());
+  header.size = size;
+  header.max_dtm = max_dtm;
+
+  std::ofstream ostr(filename, std::ios::binary);
+  ASSERT(ostr);
+  ostr.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  ostr.write(reinterpret_cast<const char*>(data), size);
+  ASSERT(ostr);
+}
+
+//
+// Probe
+//
+
+void Tablebase::add(std::unique_ptr<Table> table) {
+  max_pieces = std::max<int>(max_pieces, table->pieces.size());
+  tables[Endgame::fromCode(table->code)] = std::move(table);
+}
+
+int Tablebase::load(const string& dir, int* num_errors) {
+  int count = 0, errors = 0;
+  std::error_code ec;
+  for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+    if (it->path().extension() != ".tb") { continue; }
+    auto table = Table::fromFile(it->path().string());
+    if (!table) { errors++; continue; }
+    add(std::move(table));
+    count++;
+  }
+  if (ec) { errors++; }
+  if (num_errors) { *num_errors = errors; }
+  return count;
+}
+
+std::optional<Tablebase::ProbeResult> Tablebase::probe(const Position& pos) const {
+  int num_pieces = toSQ(pos.occupancy[kBoth]).size();
+  if (num_pieces == 2) { return ProbeResult{}; } // KvK
+  if (num_pieces > max_pieces) { return {}; }
+  if (pos.state->ep_square || pos.state->castling_rights) { return {}; }
+
+  // Swap colors if the stronger side is black
+  bool flip = false;
+  auto it = tables.find(pos.state->material_key);
+  if (it == tables.end()) {
+    flip = true;
+    it = tables.find(Endgame::flipColors(pos.state->material_key));
+    if (it == tables.end()) { return {}; }
+  }
+  auto& table = *it->second;
+
+  array<Square, kMaxPieces> squares = {};
+  auto remaining = pos.pieces;
+  for (size_t i = 0; i < table.pieces.size(); i++) {
+    auto [color, type] = table.pieces[i];
+    Board& board = remaining[flip ? !color : color][type];
+    ASSERT_HOT(board);
+    Square sq = *toSQ(board).begin();
+    board &= board - 1;
+    squares[i] = flip ? SQ::flipRank(sq) : sq;
+  }
+  Color side_to_move = flip ? !pos.side_to_move : pos.side_to_move;
+
+  uint8_t value = table.data[table.getIndex(squares, side_to_move)];
+  ASSERT_HOT(value != kIllegal);
+  if (value == 0) { return ProbeResult{}; }
+  int dtm = value - 1;
+  return ProbeResult{(dtm % 2) ? 1 : -1, dtm};
+}
+
+//
+// Generation
+//
+
+vector<string> Tablebase::listCodes(int max_pieces) {
+  // Non-king pieces of each side in descending value
+  const string kOrder = "QRBNP";
+  array<vector<string>, kMaxPieces - 1> sides;
+  sides[0] = {""};
+  for (int i = 0; i < 5; i++) {
+    sides[1].push_back(string(1, kOrder[i]));
+    for (int j = i; j < 5; j++) { sides[2].push_back(string(1, kOrder[i]) + kOrder[j]); }
+  }
+
+  auto isStronger = [&](const string& x, const string& y) {
+    if (x.size() != y.size()) { return x.size() > y.size(); }
+    for (size_t i = 0; i < x.size(); i++) {
+      if (x[i] != y[i]) { return kOrder.find(x[i]) < kOrder.find(y[i]); }
+    }
+    return true;
+  };
+
+  vector<string> res;
+  for (int k = 1; k <= max_pieces - 2; k++) {
+    for (int k_white = k; k_white >= 0; k_white--) {
+      for (auto& white : sides[k_white]) {
+        for (auto& black : sides[k - k_white]) {
+          if (isStronger(white, black)) { res.push_back("K" + white + "vK" + black); }
+        }
+      }
+    }
+  }
+
+  // Capture decreases pieces and promotion decreases pawns
+  auto count = [](const string& code, char c) { return std::count(code.begin(), code.end(), c); };
+  std::stable_sort(res.begin(), res.end(), [&](auto& x, auto& y) {
+    return pair(x.size(), count(x, 'P')) < pair(y.size(), count(y, 'P'));
+  });
+  return res;
+}
+
+namespace {
+
+// Retrograde analysis over all placements of pieces (i.e. without symmetry reduction)
+// where entry index is ((sq[0] * 64 + sq[1]) * 64 + ...) * 2 + side_to_move.
+// Positions are resolved in the order of plies to mate, where each step visits only the positions
+// resolved with that value (frontier) and their predecessors are updated by threads concurrently.
+struct Generator {
+  using Squares = array<Square, Tablebase::kMaxPieces>;
+
+  const Tablebase& tablebase;
+  const Tablebase::Table& table;
+  int n;
+  size_t num_entries;
+  int num_threads = 1;
+
+  // Same encoding as table entry (i.e. 1 + plies to mate)
+  vector<std::atomic<uint8_t>> values;
+  vector<std::atomic<uint8_t>> counts; // Non-conversion moves not yet known to lose
+  vector<uint8_t> conversion_wins; // Shortest win by conversion
+  vector<uint8_t> conversion_losses; // Longest loss by conversion
+  vector<uint8_t> conversion_draws;
+
+  // Entries resolved with each value and candidates to win by conversion with each value
+  array<vector<uint32_t>, Tablebase::kIllegal> frontiers;
+  array<vector<uint32_t>, Tablebase::kIllegal> conversions;
+
+  Generator(const Tablebase& tablebase_, const Tablebase::Table& table_)
+    : tablebase{tablebase_}, table{table_}, n(table.pieces.size()), num_entries{power64(n) * 2},
+      values(num_entries), counts(num_entries), conversion_wins(num_entries), conversion_losses(num_entries), conversion_draws(num_entries) {
+    ASSERT(num_entries <= UINT32_MAX);
+  }
+
+  Squares decode(size_t entry) const {
+    Squares squares = {};
+    entry /= 2;
+    for (int i = n - 1; i >= 0; i--) { squares[i] = entry % 64; entry /= 64; }
+    return squares;
+  }
+
+  size_t encode(const Squares& squares, Color side_to_move) const {
+    size_t entry = 0;
+    for (int i = 0; i < n; i++) { entry = entry * 64 + squares[i]; }
+    return entry * 2 + side_to_move;
+  }
+
+  // False if not a legal position
+  bool setPosition(Position& pos, const Squares& squares, Color side_to_move) const {
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < i; j++) { if (squares[i] == squares[j]) { return false; } }
+      if (table.pieces[i].second == kPawn && (toBB(squares[i]) & (kBackrankBB[kWhite] | kBackrankBB[kBlack]))) { return false; }
+    }
+    pos.pieces = {};
+    pos.occupancy = {};
+    fillArray(pos.mailbox, Position::kEmpty);
+    pos.state = &pos.state_stack[0];
+    *pos.state = {};
+    for (int i = 0; i < n; i++) {
+      pos.putPiece(table.pieces[i].first, table.pieces[i].second, squares[i], /* temporary */ true);
+    }
+    pos.side_to_move = side_to_move;
+    pos.recompute(1);
+    return !pos.getAttackers(!side_to_move, pos.kingSQ(!side_to_move));
+  }
+
+  // Terminal positions, conversions (i.e. capture and promotion to already generated tables) and move counts
+  void initialize(size_t begin, size_t end) {
+    Position pos;
+    MoveList moves;
+    for (size_t entry = begin; entry < end; entry++) {
+      if (!setPosition(pos, decode(entry), entry % 2)) { values[entry] = Tablebase::kIllegal; continue; }
+
+      moves.clear();
+      pos.generateMoves(moves);
+      int num_legal = 0, count = 0;
+      uint8_t win = 0, loss = 0;
+      bool draw = false;
+      for (auto move : moves) {
+        if (!pos.isLegal(move)) { continue; }
+        num_legal++;
+        if (!pos.isCaptureOrPromotion(move)) { count++; continue; }
+
+        pos.makeMove(move, /* temporary */ true);
+        auto result = tablebase.probe(pos);
+        pos.unmakeMove(move, /* temporary */ true);
+        ASSERT(result);
+        uint8_t value = result->dtm + 2;
+        if (result->wdl < 0) { win = win ? std::min(win, value) : value; }
+        if (result->wdl == 0) { draw = true; }
+        if (result->wdl > 0) { loss = std::max(loss, value); }
+      }
+
+      if (num_legal == 0) { values[entry] = pos.state->checkers ? 1 : 0; continue; } // Checkmate or stalemate
+
+      counts[entry] = count;
+      conversion_wins[entry] = win;
+      conversion_losses[entry] = loss;
+      conversion_draws[entry] = draw;
+      if (count == 0 && !win && !draw) { values[entry] = loss; }
+    }
+  }
+
+  // Positions which reach the entry by non-conversion move
+  template<typename F>
+  void forEachPredecessor(size_t entry, F f) const {
+    auto squares = decode(entry);
+    Color mover = !(entry % 2);
+    Board occ = 0;
+    for (int i = 0; i < n; i++) { occ |= toBB(squares[i]); }
+
+    for (int i = 0; i < n; i++) {
+      auto [color, type] = table.pieces[i];
+      if (color != mover) { continue; }
+      Square to = squares[i];
+      Board froms = 0;
+      if (type == kPawn) {
+        Direction dir = kPawnPushDirs[mover];
+        Square from = to - dir;
+        if (SQ::isValid(from) && !(occ & toBB(from))) {
+          froms |= toBB(from);
+          Rank double_push_rank = (mover == kWhite) ? kRank4 : kRank5;
+          if (SQ::toRank(to) == double_push_rank && !(occ & toBB(from - dir))) { froms |= toBB(from - dir); }
+        }
+      }
+      if (type == kKnight) { froms = knight_attack_table[to]; }
+      if (type == kBishop) { froms = getBishopAttack(to, occ); }
+      if (type == kRook)   { froms = getRookAttack(to, occ); }
+      if (type == kQueen)  { froms = getQueenAttack(to, occ); }
+      if (type == kKing)   { froms = king_attack_table[to]; }
+
+      for (auto from : toSQ(froms & ~occ)) {
+        auto tmp = squares;
+        tmp[i] = from;
+        f(encode(tmp, mover));
+      }
+    }
+  }
+
+  // Run f(begin, end, thread_index) over [0, size) split by threads
+  template<typename F>
+  void parallelFor(size_t size, F f) const {
+    vector<std::thread> threads;
+    size_t chunk = (size + num_threads - 1) / num_threads;
+    for (int i = 0; i < num_threads; i++) {
+      size_t begin = std::min(size, i * chunk), end = std::min(size, (i + 1) * chunk);
+      threads.emplace_back([&f, begin, end, i]() { f(begin, end, i); });
+    }
+    for (auto& thread : threads) { thread.join(); }
+  }
+
+  // Update predecessors of frontier and return newly resolved entries
+  // (only one thread resolves an entry since either claim by CAS or decrement to zero is unique)
+  vector<uint32_t> propagate(const vector<uint32_t>& frontier, int value, size_t begin, size_t end) {
+    vector<uint32_t> resolved;
+    bool lost = value % 2; // i.e. even plies to mate
+    for (size_t i = begin; i < end; i++) {
+      forEachPredecessor(frontier[i], [&](size_t prev) {
+        if (values[prev].load(std::memory_order_relaxed) != 0) { return; } // Already resolved or illegal
+        if (lost) {
+          uint8_t expected = 0;
+          if (!values[prev].compare_exchange_strong(expected, value + 1, std::memory_order_relaxed)) { return; }
+        } else {
+          if (counts[prev].fetch_sub(1, std::memory_order_relaxed) > 1 || conversion_wins[prev] || conversion_draws[prev]) { return; }
+          values[prev].store(std::max<int>(value + 1, conversion_losses[prev]), std::memory_order_relaxed);
+        }
+        resolved.push_back(prev);
+      });
+    }
+    return resolved;
+  }
+
+  void run(int num_threads_) {
+    num_threads = num_threads_;
+
+    // Initialize in parallel by splitting entries
+    parallelFor(num_entries, [&](size_t begin, size_t end, int) { initialize(begin, end); });
+
+    int max_value = 0;
+    for (size_t entry = 0; entry < num_entries; entry++) {
+      int value = values[entry].load(std::memory_order_relaxed);
+      if (value == Tablebase::kIllegal) { continue; }
+      if (value > 0) { frontiers[value].push_back(entry); }
+      if (value == 0 && conversion_wins[entry]) { conversions[conversion_wins[entry]].push_back(entry); }
+      max_value = std::max<int>({max_value, value, conversion_wins[entry]});
+    }
+
+    // Resolve positions in the order of plies to mate
+    for (int value = 1; value <= max_value; value++) {
+      ASSERT(value + 1 < Tablebase::kIllegal);
+      auto& frontier = frontiers[value];
+
+      for (auto entry : conversions[value]) {
+        uint8_t expected = 0;
+        if (values[entry].compare_exchange_strong(expected, value)) { frontier.push_back(entry); }
+      }
+
+      vector<vector<uint32_t>> resolved(num_threads);
+      parallelFor(frontier.size(), [&](size_t begin, size_t end, int i) { resolved[i] = propagate(frontier, value, begin, end); });
+      for (auto& entries : resolved) {
+        for (auto entry : entries) {
+          int resolved_value = values[entry].load(std::memory_order_relaxed);
+          frontiers[resolved_value].push_back(entry);
+          max_value = std::max(max_value, resolved_value);
+        }
+      }
+      vector<uint32_t>().swap(frontier);
+      vector<uint32_t>().swap(conversions[value]);
+    }
+  }
+};
+
+}; // namespace
+
+std::unique_ptr<Tablebase::Table> Tablebase::generate(const string& code, int num_threads) const {
+  auto table = std::make_unique<Table>(code);
+  Generator generator(*this, *table);
+  generator.run(num_threads);
+
+  // Keep only canonical placements (every compact entry is covered by its own placement)
+  table->size = Table::getSize(table->pieces.size(), table->has_pawns);
+  table->owned.assign(table->size, kIllegal);
+  for (size_t entry = 0; entry < generator.num_entries; entry++) {
+    uint8_t value = generator.values[entry];
+    table->owned[table->getIndex(generator.decode(entry), entry % 2)] = value;
+    if (value != kIllegal && value > 0) { table->max_dtm = std::max<uint32_t>(table->max_dtm, value - 1); }
+  }
+  table->data = table->owned.data();
+  return table;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "base.hpp"
+#include "evaluation.hpp"
+#include "endgame.hpp"
+#include "position_fwd.hpp"
+
+//
+// Endgame tablebase with distance to mate of all positions up to 4 pieces (cf. tablebase_generator.cpp)
+//
+// - A table covers a single material signature (e.g. "KRvKP") where white is the stronger side.
+//   The other coloring is probed by swapping colors and flipping ranks.
+// - Entry is a single byte for each (position, side to move):
+//     0           : draw
+//     1 + plies   : plies to mate, which is odd if side to move wins and even if it loses
+//     kIllegal    : not a legal position
+// - Position is indexed by squares of pieces in the order of code, where white king is restricted
+//   by symmetry to a1-d1-d4 triangle for pawnless tables and files a-d otherwise.
+// - Castling and en passant are ignored (probe gives up on such positions).
+//
+
+struct Tablebase {
+  static inline constexpr int kMaxPieces = 4;
+  static inline constexpr uint8_t kIllegal = 255;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_pieces;
+    char code[16];
+    uint64_t size; // Number of entries following header
+    uint32_t max_dtm;
+    uint32_t padding[5];
+  };
+  static_assert(sizeof(Header) == 64);
+
+  static inline constexpr char kMagic[8] = {'T', 'O', 'Y', 'C', 'H', 'S', 'T', 'B'};
+  static inline constexpr uint32_t kVersion = 1;
+
+  struct Table {
+    string code;
+    vector<pair<Color, PieceType>> pieces; // Order of code
+    bool has_pawns = false;
+    uint32_t max_dtm = 0;
+
+    // Either read-only mmap of file or owned buffer (right after generation)
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    void* mapped = nullptr;
+    size_t mapped_size = 0;
+    vector<uint8_t> owned;
+
+    Table(const string& code);
+    Table(const Table&) = delete;
+    ~Table();
+
+    static size_t getSize(int num_pieces, bool has_pawns);
+    size_t getIndex(array<Square, kMaxPieces> squares, Color side_to_move) const;
+
+    static std::unique_ptr<Table> fromFile(const string& filename); // nullptr if invalid
+    void save(const string& filename) const;
+  };
+
+  struct ProbeResult {
+    int wdl = 0; // 1 (win), 0 (draw), -1 (loss) for side to move
+    int dtm = 0; // Plies to mate
+  };
+
+  std::unordered_map<Endgame::MaterialKey, std::unique_ptr<Table>> tables;
+  int max_pieces = 0; // Probe is skipped with more pieces
+
+  void clear() { tables.clear(); max_pieces = 0; }
+  void add(std::unique_ptr<Table>);
+
+  // Load all "<code>.tb" files in directory and return the number of tables
+  // (invalid files and directory errors are skipped and counted in "num_errors")
+  int load(const string& dir, int* num_errors = nullptr);
+
+  std::optional<ProbeResult> probe(const Position&) const;
+
+  // Mate score relative to root as Evaluation::mateScore
+  static Score toScore(const ProbeResult& result, int depth) {
+    if (result.wdl == 0) { return kScoreDraw; }
+    Score score = Evaluation::mateScore(depth + result.dtm);
+    return result.wdl > 0 ? score : -score;
+  }
+
+  //
+  // Generation by retrograde analysis
+  //
+
+  // Canonical codes ordered such that conversions (capture/promotion) of each table precede it
+  static vector<string> listCodes(int max_pieces = kMaxPieces);
+
+  // Tables reachable by conversion have to be added already
+  std::unique_ptr<Table> generate(const string& code, int num_threads = 1) const;
+};
@@ -0,0 +1,34 @@
+#include "tablebase.hpp"
+
+int main(int argc, const char* argv[]) {
+  Cli cli{argc, argv};
+  auto outdir = cli.getArg<string>("--outdir");
+  int max_pieces = cli.getArg<int>("--max-pieces").value_or(Tablebase::kMaxPieces);
+  int num_threads = cli.getArg<int>("--threads").value_or(std::thread::hardware_concurrency());
+  if (!outdir || !(3 <= max_pieces && max_pieces <= Tablebase::kMaxPieces) || num_threads <= 0) {
+    std::cerr << cli.help() << std::endl;
+    return 1;
+  }
+  std::filesystem::create_directories(*outdir);
+
+  // Conversions of each table are generated (or loaded) before it
+  Tablebase tablebase;
+  for (auto& code : Tablebase::listCodes(max_pieces)) {
+    auto filename = *outdir + "/" + code + ".tb";
+    if (std::filesystem::exists(filename)) {
+      if (auto existing = Tablebase::Table::fromFile(filename)) {
+        tablebase.add(std::move(existing));
+        std::cerr << ":: " << code << " (exists)" << std::endl;
+        continue;
+      }
+      std::cerr << ":: " << code << " (invalid file is regenerated)" << std::endl;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto table = tablebase.generate(code, num_threads);
+    table->save(filename);
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << ":: " << code << " (max_dtm = " << table->max_dtm << ", time = " << time << "ms)" << std::endl;
+    tablebase.add(std::move(table));
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "tablebase.hpp"
+#include "engine.hpp"
+#include "test_utils.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+// 3 pieces tables are generated only once
+static Tablebase& getTablebase() {
+  static Tablebase tablebase = []() {
+    Tablebase res;
+    for (auto& code : Tablebase::listCodes(3)) { res.add(res.generate(code, /* num_threads */ 2)); }
+    return res;
+  }();
+  return tablebase;
+}
+
+TEST_CASE("Tablebase::listCodes") {
+  CHECK(toString(Tablebase::listCodes(3)) == "{KQvK, KRvK, KBvK, KNvK, KPvK}");
+  auto codes = Tablebase::listCodes(4);
+  CHECK(codes.size() == 35);
+  CHECK(std::count(codes.begin(), codes.end(), "KNvKP") == 1);
+  CHECK(std::count(codes.begin(), codes.end(), "KPvKN") == 0);
+  CHECK(codes.back() == "KPvKP");
+}
+
+TEST_CASE("Tablebase::generate") {
+  auto& tablebase = getTablebase();
+  REQUIRE(tablebase.max_pieces == 3);
+
+  // Longest mates (KQvK 10 moves, KRvK 16 moves) counted from losing side to move
+  CHECK(tablebase.tables.at(Endgame::fromCode("KQvK"))->max_dtm == 20);
+  CHECK(tablebase.tables.at(Endgame::fromCode("KRvK"))->max_dtm == 32);
+  CHECK(tablebase.tables.at(Endgame::fromCode("KBvK"))->max_dtm == 0);
+
+  auto probe = [&](const string& fen) {
+    auto result = tablebase.probe(Position(fen));
+    REQUIRE(result);
+    return std::pair(result->wdl, result->dtm);
+  };
+  CHECK(probe("7k/8/6K1/8/8/8/8/R7 w - - 0 1") == std::pair(1, 1)); // Ra8#
+  CHECK(probe("7k/8/6K1/8/8/8/8/R7 b - - 0 1").first == -1);
+  CHECK(probe("r7/8/8/8/8/6k1/8/7K b - - 0 1") == std::pair(1, 1)); // Colors swapped
+  CHECK(probe("8/8/8/4k3/8/8/1K6/7R b - - 0 1").first == -1);
+  CHECK(probe("8/8/8/8/8/8/1K5k/7R b - - 0 1").first == 0); // Kxh1
+  CHECK(probe("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1").first == -1);
+  CHECK(probe("4k3/4P3/4K3/8/8/8/8/8 b - - 0 1").first == 0); // Stalemate
+  CHECK(probe("8/8/8/8/8/4k3/8/4K1N1 w - - 0 1").first == 0);
+
+  // Castling rights or en passant are not covered
+  CHECK_FALSE(tablebase.probe(Position("4k3/8/8/8/8/8/8/4K2R w K - 0 1")));
+}
+
+TEST_CASE("Tablebase::Table::save") {
+  auto& table = *getTablebase().tables.at(Endgame::fromCode("KPvK"));
+  string filename = test_utils::makeTempPath("tablebase-test.tb");
+  table.save(filename);
+  {
+    auto loaded = Tablebase::Table::fromFile(filename);
+    CHECK(loaded->code == "KPvK");
+    CHECK(loaded->max_dtm == table.max_dtm);
+    REQUIRE(loaded->size == table.size);
+    CHECK(std::memcmp(loaded->data, table.data, table.size) == 0);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("Tablebase::load") {
+  auto& table = *getTablebase().tables.at(Endgame::fromCode("KPvK"));
+  auto dir = test_utils::makeTempPath("tablebase-dir");
+  std::filesystem::create_directories(dir);
+  table.save(dir + "/KPvK.tb");
+
+  // Invalid files are rejected instead of aborting
+  std::ifstream istr(dir + "/KPvK.tb", std::ios::binary);
+  string data((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+  auto write = [&](const string& name, const string& content) {
+    std::ofstream ostr(dir + "/" + name, std::ios::binary);
+    ostr << content;
+  };
+  auto stale = data;
+  stale[8]++; // version
+  write("truncated.tb", data.substr(0, data.size() - 1));
+  write("stale.tb", stale);
+  write("garbage.tb", "garbage");
+  write("ignored.txt", "garbage");
+  CHECK(Tablebase::Table::fromFile(dir + "/truncated.tb") == nullptr);
+  CHECK(Tablebase::Table::fromFile(dir + "/stale.tb") == nullptr);
+  CHECK(Tablebase::Table::fromFile(dir + "/garbage.tb") == nullptr);
+  CHECK(Tablebase::Table::fromFile(dir + "/non-existent.tb") == nullptr);
+
+  Tablebase tablebase;
+  int num_errors = 0;
+  CHECK(tablebase.load(dir, &num_errors) == 1);
+  CHECK(num_errors == 3);
+  CHECK(tablebase.tables.count(Endgame::fromCode("KPvK")));
+  std::filesystem::remove_all(dir);
+
+  CHECK(tablebase.load(dir, &num_errors) == 0);
+  CHECK(num_errors == 1);
+}
+
+TEST_CASE("Engine::searchImpl (tablebase)") {
+  Engine engine;
+  for (auto& [key, table] : getTablebase().tables) {
+    auto copy = std::make_unique<Tablebase::Table>(table->code);
+    copy->max_dtm = table->max_dtm;
+    copy->owned.assign(table->data, table->data + table->size);
+    copy->data = copy->owned.data();
+    copy->size = table->size;
+    engine.tablebase.add(std::move(copy));
+  }
+
+  auto fen = "8/8/8/3k4/8/8/8/Q3K3 w - - 0 1";
+  auto expected = engine.tablebase.probe(Position(fen));
+  REQUIRE(expected);
+  REQUIRE(expected->wdl == 1);
+  engine.position.initialize(fen);
+  engine.go_parameters.depth = 2;
+  engine.go(/* blocking */ true);
+  auto& result = engine.results.back();
+  CHECK(result.score == Evaluation::mateScore(expected->dtm));
+  CHECK(result.stats_tb_hit > 0);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "base.hpp"
+#include "misc.hpp"
+#include "nn/weight_file.hpp"
+#include <unistd.h>
+
+//
+// Helpers shared by tests
+//
+
+namespace test_utils {
+
+// Unique path in temporary directory so that concurrent test runs don't collide (file is not created)
+inline string makeTempPath(const string& name) {
+  static std::atomic<int> counter = 0;
+  auto filename = toString("toy-chess", getpid(), counter++, name);
+  std::replace(filename.begin(), filename.end(), ' ', '-');
+  return (std::filesystem::temp_directory_path() / filename).string();
+}
+
+// Random weight in legacy format (i.e. consecutive float matrices and biases of four layers)
+inline std::shared_ptr<const nn::WeightFile> makeWeightFile(const array<uint32_t, 5>& dims, nn::WeightFile::FeatureSet feature_set = nn::WeightFile::kHalfKP) {
+  vector<float> data;
+  Rng rng;
+  for (int i = 0; i < 4; i++) {
+    size_t n_in = dims[i] * (i == 1 ? 2 : 1), n_out = dims[i + 1];
+    for (size_t j = 0; j < (n_in + 1) * n_out; j++) { data.push_back((float(rng.next()) / float(UINT32_MAX) - 0.5f) / 16); }
+  }
+  return nn::WeightFile::fromLegacy(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float), dims, feature_set);
+}
+
+}; // namespace test_utils
@@ -1,4 +1,5 @@
 #include "uci.hpp"
+#include "mate_solver.hpp"
 
 UCI::UCI(std::istream& istr, std::ostream& ostr, std::ostream& err_ostr)
   : istr{istr}, ostr{ostr}, err_ostr{err_ostr} {
@@ -19,15 +20,97 @@ UCI::UCI(std::istream& istr, std::ostream& ostr, std::ostream& err_ostr)
     }
   });
 
+  options.push_back({
+    "EvalCache", toString("type spin default", Engine::kDefaultEvaluationCacheSizeMB, "min 0 max 1024"),
+    [this](std::istream& line){
+      engine.stop();
+      int value = std::stoi(readToken(line));
+      ASSERT(0 <= value && value <= 1024);
+      engine.setEvaluationCacheSizeMB(value);
+    }
+  });
+
   options.push_back({
     "WeightFile", toString("type string default", Engine::kEmbeddedWeightName),
     [this](std::istream& line){
       engine.stop();
       string value = readToken(line);
-      engine.loadWeight(value);
+      if (!engine.loadWeight(value)) { printError("Invalid weight file or unsupported architecture [" + value + "]"); }
+    }
+  });
+
+  options.push_back({
+    "SmallWeightFile", "type string default <empty>",
+    [this](std::istream& line){
+      engine.stop();
+      string value = readToken(line);
+      if (value == "<empty>") { value = ""; }
+      if (!engine.loadSmallWeight(value)) { printError("Invalid weight file or unsupported architecture [" + value + "]"); }
+    }
+  });
+
+  options.push_back({
+    "UseSmallNetwork", "type check default false",
+    [this](std::istream& line){
+      engine.stop();
+      engine.setUseSmallNetwork(readToken(line) == "true");
+    }
+  });
+
+  options.push_back({
+    "BookFile", "type string default <empty>",
+    [this](std::istream& line){
+      engine.stop();
+      string value = readToken(line);
+      if (value == "<empty>") { value = ""; }
+      if (!engine.loadBook(value)) { printError("Invalid book file [" + value + "]"); }
     }
   });
 
+  options.push_back({
+    "TablebasePath", "type string default <empty>",
+    [this](std::istream& line){
+      engine.stop();
+      string value = readToken(line);
+      if (value == "<empty>") { value = ""; }
+      if (!value.empty() && !std::filesystem::is_directory(value)) { printError("Invalid tablebase path [" + value + "]"); return; }
+      int num_errors = 0;
+      engine.loadTablebase(value, &num_errors);
+      if (num_errors > 0) { printError(toString("Skipped", num_errors, "invalid tablebase file(s) in [" + value + "]")); }
+    }
+  });
+
+  options.push_back({
+    "MultiPV", "type spin default 1 min 1 max 256",
+    [this](std::istream& line){
+      engine.stop();
+      int value = std::stoi(readToken(line));
+      ASSERT(1 <= value && value <= 256);
+      engine.multi_pv = value;
+    }
+  });
+
+  options.push_back({
+    "Deterministic", "type check default false",
+    [this](std::istream& line){
+      engine.stop();
+      engine.deterministic = (readToken(line) == "true");
+    }
+  });
+
+  options.push_back({
+    "Move Overhead", "type spin default 10 min 0 max 5000",
+    [this](std::istream& line){
+      engine.stop();
+      int value = std::stoi(readToken(line));
+      ASSERT(0 <= value && value <= 5000);
+      engine.time_control.move_overhead = value;
+    }
+  });
+
+  // Only tells GUI that "go ponder" is supported
+  options.push_back({"Ponder", "type check default false", [](std::istream&){}});
+
   // TODO: Not sure how to set "debug on" on cutechess-cli, so here is an easy workaround.
   options.push_back({"Debug", "type check default false", [this](std::istream& line){ engine.debug = (readToken(line) == "true"); }});
 }
@@ -92,6 +175,7 @@ void UCI::handleCommand(const string& s_command) {
   // Custom commands
   else if (token == "toy-debug") { toy_debug(command); }
   else if (token == "toy-perft") { toy_perft(command); }
+  else if (token == "toy-mate")  { toy_mate(command); }
 
   else {
     printError("Unknown command [" + token + "]");
@@ -118,35 +202,36 @@ void UCI::uci_position(std::istream& command) {
       fen += readToken(command);
     }
   }
-  engine.position.initialize(fen);
 
+  vector<string> moves;
   auto token = readToken(command);
-  if (token.empty()) { return; }
-  if (token != "moves") { printError("Invalid position command"); return; }
-
-  // In order to distinguish move types (e.g. castling/enpassant), we need full move generation.
-  // TODO: To detect 3-folds repetition, we need to keep some moves on stack
-  for (int i = 0; ; i++) {
-    // Reset when reaching stack limit
-    if (i == Position::kMaxDepth) { engine.position.reset(); i = 0; }
-
-    auto s_move = readToken(command);
-    if (s_move.empty()) { break; }
-
-    MoveList move_list;
-    engine.position.generateMoves(move_list);
-    bool found = 0;
-    for (auto move : move_list) {
-      if (!engine.position.isLegal(move)) { continue; }
-      if (toString(move) == s_move) {
-        found = 1;
-        engine.position.makeMove(move);
-        break;
-      }
+  if (!token.empty()) {
+    if (token != "moves") { printError("Invalid position command"); return; }
+    for (string s_move; !(s_move = readToken(command)).empty(); ) { moves.push_back(s_move); }
+  }
+
+  // Only apply new moves if it extends previous command (usual during game)
+  bool extends = (fen == position_fen && moves.size() >= position_moves.size() &&
+                  std::equal(position_moves.begin(), position_moves.end(), moves.begin()));
+  size_t start = extends ? position_moves.size() : 0;
+  if (!extends) { engine.position.initialize(fen); }
+  position_fen = fen;
+  position_moves = moves;
+
+  for (size_t i = start; i < moves.size(); i++) {
+    // Move keys to history when reaching stack limit
+    if (engine.position.state == &engine.position.state_stack[Position::kMaxDepth]) { engine.position.reset(); }
+
+    Move move = engine.position.parseUCI(moves[i]);
+    if (move == kNoneMove) {
+      printError("Invalid move [" + moves[i] + "]");
+      position_moves.resize(i);
+      break;
     }
-    ASSERT(found);
+    engine.position.makeMove(move);
   }
 
+  // Search starts from empty stack
   engine.position.reset();
 }
 
@@ -156,19 +241,28 @@ void UCI::uci_go(std::istream& command) {
   string token;
   auto& params = engine.go_parameters;
   params = {};
-  while (command >> token) {
-    if (token == "searchmoves") { ASSERT(0); }
-    if (token == "ponder") { ASSERT(0); }
+  bool pending = false; // Token after "searchmoves" is read already
+  while (pending || command >> token) {
+    pending = false;
+    if (token == "searchmoves") {
+      while (command >> token) {
+        Move move = engine.position.parseUCI(token);
+        if (move == kNoneMove) { pending = true; break; } // Next parameter (or invalid move)
+        params.searchmoves.put(move);
+      }
+      continue;
+    }
+    if (token == "ponder") { params.ponder = true; }
     if (token == "wtime") { command >> params.time[kWhite]; }
     if (token == "btime") { command >> params.time[kBlack]; }
-    if (token == "winc") { command >> params.inc[kBlack]; }
+    if (token == "winc") { command >> params.inc[kWhite]; }
     if (token == "binc") { command >> params.inc[kBlack]; }
     if (token == "movestogo") { command >> params.movestogo; }
     if (token == "depth") { command >> params.depth; ASSERT(params.depth > 0); }
-    if (token == "nodes") { ASSERT(0); }
-    if (token == "mate") { ASSERT(0); }
+    if (token == "nodes") { command >> params.nodes; ASSERT(params.nodes > 0); }
+    if (token == "mate") { command >> params.mate; ASSERT(params.mate > 0); }
     if (token == "movetime") { command >> params.movetime; }
-    if (token == "infinite") { params.depth = Position::kMaxDepth; }
+    if (token == "infinite") { params.depth = Position::kMaxDepth; params.infinite = true; }
   }
 
   engine.go(/* blocking */ false);
@@ -181,7 +275,9 @@ void UCI::toy_debug(std::istream&) {
 
 void UCI::toy_perft(std::istream& command) {
   engine.stop();
+  auto small_evaluator = engine.position.small_evaluator;
   engine.position.evaluator = nullptr;
+  engine.position.small_evaluator = nullptr;
   int depth = 1;
   command >> depth;
   auto start = std::chrono::steady_clock::now();
@@ -196,4 +292,27 @@ void UCI::toy_perft(std::istream& command) {
   ostr << "total: " << total << "\n";
   ostr << "time: " << std::fixed << std::setprecision(3) << time << "\n";
   engine.position.evaluator = &engine.evaluator;
+  engine.position.small_evaluator = small_evaluator;
+}
+
+void UCI::toy_mate(std::istream& command) {
+  // toy-mate [<max_nodes>] (0 for no limit)
+  engine.stop();
+  int64_t max_nodes = kDefaultMateNodes;
+  command >> max_nodes;
+  MateSolver solver(engine.position);
+  auto start = std::chrono::steady_clock::now();
+  auto result = solver.solve(max_nodes);
+  auto finish = std::chrono::steady_clock::now();
+  float time = (float)std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count() / 1000;
+  if (result.status == MateSolver::kProven) {
+    ostr << "mate: " << (result.pv.size() + 1) / 2 << "\n";
+    ostr << "pv:";
+    for (auto move : result.pv) { ostr << " " << move; }
+    ostr << "\n";
+  } else {
+    ostr << "mate: " << (result.status == MateSolver::kDisproven ? "none" : "unknown") << "\n";
+  }
+  ostr << "nodes: " << result.nodes << "\n";
+  ostr << "time: " << std::fixed << std::setprecision(3) << time << "\n";
 }
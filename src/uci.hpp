@@ -33,6 +33,10 @@ struct UCI {
 
   Engine engine;
 
+  // Last "position" command (cf. uci_position)
+  string position_fen;
+  vector<string> position_moves;
+
   UCI(std::istream&, std::ostream&, std::ostream&);
   int mainLoop();
   void startCommandListenerThread();
@@ -83,7 +87,10 @@ struct UCI {
     // setoption name <id> [value <x>]
     ASSERT(readToken(command) == "name");
     auto id = readToken(command);
-    ASSERT(readToken(command) == "value");
+    for (string token; (token = readToken(command)) != "value"; ) { // Name can have spaces
+      ASSERT(!token.empty());
+      id += " " + token;
+    }
     for (auto& option : options) {
       if (option.id == id) { option.handler(command); return; }
     }
@@ -97,6 +104,8 @@ struct UCI {
   void uci_ucinewgame(std::istream&) {
     engine.stop();
     engine.reset();
+    position_fen.clear();
+    position_moves.clear();
   }
 
   void uci_position(std::istream&);
@@ -107,9 +116,12 @@ struct UCI {
   }
 
   void uci_ponderhit(std::istream&) {
-    printError("Unsupported command [ponderhit]");
+    engine.ponderhit();
   }
 
   void toy_debug(std::istream&);
   void toy_perft(std::istream&);
+
+  static inline const int64_t kDefaultMateNodes = 10'000'000; // So that "toy-mate" always terminates
+  void toy_mate(std::istream&);
 };
@@ -1,4 +1,5 @@
 #include "uci.hpp"
+#include "test_utils.hpp"
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
 using Catch::Matchers::Contains;
@@ -83,7 +84,16 @@ TEST_CASE("UCI") {
     "name toy-chess",
     "author hiro18181",
     "option name Hash type spin default 128 min 1 max 16384",
+    "option name EvalCache type spin default 4 min 0 max 1024",
     "option name WeightFile type string default __EMBEDDED_WEIGHT__",
+    "option name SmallWeightFile type string default <empty>",
+    "option name UseSmallNetwork type check default false",
+    "option name BookFile type string default <empty>",
+    "option name TablebasePath type string default <empty>",
+    "option name MultiPV type spin default 1 min 1 max 256",
+    "option name Deterministic type check default false",
+    "option name Move Overhead type spin default 10 min 0 max 5000",
+    "option name Ponder type check default false",
     "option name Debug type check default false",
     "uciok",
   }}) == 1);
@@ -95,8 +105,95 @@ TEST_CASE("UCI") {
   CHECK(tester.putAndCheck("position fen 8/2k5/7R/6R1/8/4K3/8/8 w - - 0 1", {}) == 1);
 
   tester.putLine("go depth 4");
-  CHECK(tester.getLineUntil([&](auto line) { return line == "bestmove g5g7"; }) == true);
+  CHECK(tester.getLineUntil([&](auto line) { return line.rfind("bestmove g5g7", 0) == 0; }) == true);
+
+  tester.putLine("go searchmoves e3d3 e3f2 depth 3");
+  CHECK(tester.getLineUntil([&](auto line) { return line.rfind("bestmove e3d3", 0) == 0 || line.rfind("bestmove e3f2", 0) == 0; }) == true);
+
+  tester.putLine("go mate 2");
+  CHECK(tester.getLineUntil([&](auto line) { return line.find("score mate 2") != string::npos; }) == true);
+  CHECK(tester.getLineUntil([&](auto line) { return line.rfind("bestmove g5g7", 0) == 0; }) == true);
+
+  tester.putLine("go ponder depth 2");
+  tester.putLine("ponderhit");
+  CHECK(tester.getLineUntil([&](auto line) { return line.rfind("bestmove g5g7", 0) == 0; }) == true);
 
   tester.putLine("quit");
   CHECK(tester.waitFor(std::chrono::milliseconds(100)) == std::future_status::ready);
 }
+
+TEST_CASE("UCI::uci_position") {
+  std::stringstream istr, ostr, err_ostr;
+  UCI uci(istr, ostr, err_ostr);
+  auto& pos = uci.engine.position;
+
+  // Repetition before root
+  uci.handleCommand("position startpos moves g1f3 g8f6 f3g1 f6g8");
+  CHECK(pos.state == &pos.state_stack[0]);
+  CHECK(pos.key_history.size() == 4);
+  CHECK(pos.isRepetition());
+
+  // Only new moves are applied
+  uci.handleCommand("position startpos moves g1f3 g8f6 f3g1 f6g8 e1e2");
+  CHECK(ostr.str().find("Invalid move [e1e2]") != string::npos);
+  CHECK(uci.position_moves.size() == 4);
+  uci.handleCommand("position startpos moves g1f3 g8f6 f3g1 f6g8 e2e4 e7e5 e1g1");
+  CHECK(ostr.str().find("Invalid move [e1g1]") != string::npos);
+  uci.handleCommand("position startpos moves g1f3 g8f6 f3g1 f6g8 e2e4 e7e5 g1f3 b8c6 f1c4 f8c5 e1g1 g8f6 d2d3 e8g8");
+  CHECK(pos.toFen() == "r1bq1rk1/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQ1RK1 w - - 0 8");
+  CHECK(pos.key_history.empty()); // Castling resets rule50
+  CHECK(!pos.isRepetition());
+
+  // Different position
+  uci.handleCommand("position fen 8/2k5/7R/6R1/8/4K3/8/8 w - - 0 1 moves g5g7 c7d8");
+  CHECK(pos.toFen() == "3k4/6R1/7R/8/8/4K3/8/8 w - - 2 2");
+  CHECK(pos.key_history.size() == 2);
+
+  // Game longer than search stack
+  string command = "position startpos moves";
+  for (int i = 0; i < (Position::kMaxDepth + 40) / 4; i++) { command += " g1f3 g8f6 f3g1 f6g8"; }
+  uci.handleCommand(command);
+  CHECK(pos.toFen() == "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 296 149");
+  CHECK(pos.key_history.size() == 296);
+  CHECK(pos.isRepetition());
+}
+
+TEST_CASE("UCI::uci_setoption") {
+  std::stringstream istr, ostr, err_ostr;
+  UCI uci(istr, ostr, err_ostr);
+
+  // Invalid weight file is reported and current weight is kept
+  uci.handleCommand("setoption name WeightFile value /non-existent-toy-chess-weight.bin");
+  CHECK(ostr.str().find("info string ERROR Invalid weight file") == 0);
+  CHECK(uci.engine.evaluator.architecture() == "HalfKP-128x32x32");
+
+  // Invalid tablebase files are skipped and reported
+  auto dir = test_utils::makeTempPath("tablebase-dir");
+  std::filesystem::create_directories(dir);
+  std::ofstream(dir + "/KQvK.tb") << "garbage";
+  ostr.str("");
+  uci.handleCommand("setoption name TablebasePath value " + dir);
+  CHECK(ostr.str().find("info string ERROR Skipped 1 invalid tablebase file(s)") == 0);
+  CHECK(uci.engine.tablebase.tables.empty());
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("UCI::toy_mate") {
+  std::stringstream istr, ostr, err_ostr;
+  UCI uci(istr, ostr, err_ostr);
+  uci.handleCommand("position fen 8/8/2k5/7R/6R1/4K3/8/8 w - - 0 1");
+  uci.handleCommand("toy-mate");
+  string line;
+  std::getline(ostr, line);
+  CHECK(line == "mate: 3");
+  std::getline(ostr, line);
+  CHECK(line == "pv: g4g6 c6b7 h5h7 b7a8 g6g8");
+
+  std::getline(ostr, line); // nodes
+  std::getline(ostr, line); // time
+
+  // Give up within node limit
+  uci.handleCommand("toy-mate 2");
+  std::getline(ostr, line);
+  CHECK(line == "mate: unknown");
+}